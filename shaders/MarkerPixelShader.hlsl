@@ -0,0 +1,27 @@
+cbuffer Markers : register(b1)
+{
+    float2 AuthoredSize;            // AUTHORED_WIDTH, AUTHORED_HEIGHT
+    float2 ViewportSize;            // Render target size in pixels
+    uint   Shape;                   // MarkerShape, 0 = circle, 1 = square
+    float  Zoom;                    // Camera zoom
+    float2 Rotation;                // Cosine and sine of the camera rotation
+}
+
+struct PSInput
+{
+    float4 position : SV_POSITION;  // Transformed position (not used here)
+    float4 color    : COLOR;        // Marker color
+    float2 offset   : OFFSET;       // Offset from the marker center in pixels
+    float  radius   : RADIUS;       // Marker radius in pixels
+};
+
+float4 main(PSInput input) : SV_TARGET
+{
+    // Analytic coverage, a one pixel ramp centered on the edge
+    float2 absOffset = abs(input.offset);
+    float edgeDistance = (Shape == 0) ? length(input.offset) : max(absOffset.x, absOffset.y);
+    float coverage = saturate(input.radius - edgeDistance + 0.5f);
+    clip(coverage - (1.0f / 255.0f));
+
+    return float4(input.color.rgb, input.color.a * coverage);
+}
@@ -0,0 +1,51 @@
+cbuffer Transform : register(b0)
+{
+    float4x4 WorldViewProj;         // Combined world-view-projection matrix
+}
+
+cbuffer Markers : register(b1)
+{
+    float2 AuthoredSize;            // AUTHORED_WIDTH, AUTHORED_HEIGHT
+    float2 ViewportSize;            // Render target size in pixels
+    uint   Shape;                   // MarkerShape, 0 = circle, 1 = square
+    float  Zoom;                    // Camera zoom
+    float2 Rotation;                // Cosine and sine of the camera rotation
+}
+
+struct VSInput
+{
+    float2 corner   : CORNER;       // Quad corner, -1 to 1 (per vertex)
+    float2 position : POSITION;     // Marker center in world space (per instance)
+    float  size     : SIZE;         // Marker diameter in world space (per instance)
+    float4 color    : COLOR;        // Marker color (per instance)
+};
+
+struct PSInput
+{
+    float4 position : SV_POSITION;  // Transformed position (in clip space)
+    float4 color    : COLOR;        // Passed color
+    float2 offset   : OFFSET;       // Offset from the marker center in pixels
+    float  radius   : RADIUS;       // Marker radius in pixels
+};
+
+PSInput main(VSInput input)
+{
+    PSInput output;
+
+    // Pad the quad by a pixel so the anti-aliased edge fits inside it
+    float pixelsPerUnit = ViewportSize.x / AuthoredSize.x * Zoom;
+    float radius = input.size * 0.5f * pixelsPerUnit;
+    float2 offset = input.corner * (radius + 1.0f);
+
+    // The corner is placed in screen pixels rather than world units, which the projection scales differently on
+    // each axis when the canvas aspect isn't the authored one. Squares turn with the camera.
+    float2 screenOffset = float2(Rotation.x * offset.x - Rotation.y * offset.y, Rotation.y * offset.x + Rotation.x * offset.y);
+    float4 center = mul(WorldViewProj, float4(input.position, 0.0f, 1.0f));
+    output.position = center + float4(screenOffset * float2(2.0f, -2.0f) / ViewportSize * center.w, 0.0f, 0.0f);
+
+    output.color = input.color;
+    output.offset = offset;
+    output.radius = radius;
+
+    return output;
+}
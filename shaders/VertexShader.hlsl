@@ -3,10 +3,12 @@ cbuffer Transform : register(b0)
     float4x4 WorldViewProj;         // Combined world-view-projection matrix
 }
 
+Buffer<float4> Styles : register(t0);   // Style palette, RGBA per entry
+
 struct VSInput
 {
     float3 position : POSITION;     // Vertex position (in object space)
-    float4 color    : COLOR;        // Vertex color
+    uint   style    : STYLE;        // Index into the style palette
 };
 
 struct PSInput
@@ -22,8 +24,8 @@ PSInput main(VSInput input)
     // Transform the vertex position to clip space
     output.position = mul(WorldViewProj, float4(input.position, 1.0f));
     
-    // Pass the color through to the pixel shader
-    output.color = input.color;
+    // Resolve the style to a color for the pixel shader
+    output.color = Styles.Load(input.style);
     
     return output;
 }
\ No newline at end of file
@@ -2,73 +2,204 @@
 
 // Renderer
 #include <Renderer/RendererFactory.h>
-#include <Renderer/VectorRenderer.h>
-
-// Utils
-#include <Utils/Assert.h>
+#include <Renderer/RenderThread.h>
 
 // External
-#include <QTimer>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+// System
+#include <cmath>
 
 //------------------------------------------------------------------------------
 CanvasWidget::CanvasWidget(GraphicsBackend backend, QWidget* parent)
 	: QWidget(parent)
-	, mTimer(new QTimer(nullptr))
 {
 	setAttribute(Qt::WA_PaintOnScreen);
 	setAttribute(Qt::WA_NoSystemBackground);
 	show();
 
-	mRenderDevice = RendererFactory::Create(backend);
-	const bool initialized = mRenderDevice->Initialize(reinterpret_cast<void*>(winId()), width(), height());
-	ASSERT(initialized, "Failed to initialize render device");
+	// The device is initialized on the render thread, which owns it from here on
+	mRenderThread = new RenderThread(RendererFactory::Create(backend), reinterpret_cast<void*>(winId()), width(), height());
+}
 
-	const bool shadersLoaded = mRenderDevice->LoadShaders();
-	ASSERT(shadersLoaded, "Failed to load shaders");
+//------------------------------------------------------------------------------
+CanvasWidget::~CanvasWidget()
+{
+	delete mRenderThread;
+	mRenderThread = nullptr;
+}
 
-	mVectorRenderer = new VectorRenderer(mRenderDevice);
+//------------------------------------------------------------------------------
+ShapeHandle CanvasWidget::AddShape(IVectorShape* shape)
+{
+	return mRenderThread->AddShape(shape);
+}
 
-	// Start update loop
-	connect(mTimer, &QTimer::timeout, this, &CanvasWidget::Update);
-	mTimer->start(1000.0f / 60.0f); // ~60 FPS (TODO: Make configurable)
+//------------------------------------------------------------------------------
+void CanvasWidget::AddRects(const VectorRenderer::RectParams* rects, size_t count, ShapeHandle* handles)
+{
+	mRenderThread->AddRects(rects, count, handles);
 }
 
 //------------------------------------------------------------------------------
-CanvasWidget::~CanvasWidget()
+void CanvasWidget::AddLines(const VectorRenderer::LineParams* lines, size_t count, ShapeHandle* handles)
 {
-	disconnect(mTimer, &QTimer::timeout, this, &CanvasWidget::Update);
-	delete mTimer;
-	mTimer = nullptr;
+	mRenderThread->AddLines(lines, count, handles);
+}
 
-	delete mVectorRenderer;
-	mVectorRenderer = nullptr;
+//------------------------------------------------------------------------------
+void CanvasWidget::AddBezierCurves(const VectorRenderer::BezierCurveParams* curves, size_t count, ShapeHandle* handles)
+{
+	mRenderThread->AddBezierCurves(curves, count, handles);
+}
 
-	mRenderDevice->Shutdown();
-	delete mRenderDevice;
-	mRenderDevice = nullptr;
+//------------------------------------------------------------------------------
+void CanvasWidget::AddCubicBezierCurves(const VectorRenderer::CubicBezierCurveParams* curves, size_t count, ShapeHandle* handles)
+{
+	mRenderThread->AddCubicBezierCurves(curves, count, handles);
 }
 
 //------------------------------------------------------------------------------
-void CanvasWidget::AddShape(IVectorShape* shape)
+void CanvasWidget::UpdateShape(ShapeHandle handle, IVectorShape* shape)
 {
-	mVectorRenderer->AddShape(shape);
+	mRenderThread->UpdateShape(handle, shape);
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::RemoveShape(ShapeHandle handle)
+{
+	mRenderThread->RemoveShape(handle);
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::RestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill)
+{
+	mRenderThread->RestyleShape(handle, stroke, fill);
 }
 
 //------------------------------------------------------------------------------
 void CanvasWidget::ClearShapes()
 {
-	mVectorRenderer->ClearShapes();
+	mRenderThread->ClearShapes();
+}
+
+//------------------------------------------------------------------------------
+GroupHandle CanvasWidget::AddGroup(GroupHandle parent)
+{
+	return mRenderThread->AddGroup(parent);
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::SetGroupTransform(GroupHandle group, const Transform& transform)
+{
+	mRenderThread->SetGroupTransform(group, transform);
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::RemoveGroup(GroupHandle group)
+{
+	mRenderThread->RemoveGroup(group);
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::SetShapeGroup(ShapeHandle shape, GroupHandle group)
+{
+	mRenderThread->SetShapeGroup(shape, group);
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Batch CanvasWidget::BeginBatch()
+{
+	return mRenderThread->BeginBatch();
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::SubmitBatch(RenderThread::Batch& batch)
+{
+	mRenderThread->Submit(batch);
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::PresentScene(const SceneSnapshot& scene)
+{
+	mRenderThread->PresentScene(scene);
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::SetContinuousRendering(double framesPerSecond)
+{
+	mRenderThread->SetContinuousRendering(framesPerSecond);
+}
+
+//------------------------------------------------------------------------------
+FrameStats CanvasWidget::GetFrameStats() const
+{
+	return mRenderThread->GetFrameStats();
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::paintEvent(QPaintEvent* /*event*/)
+{
+	// The window was exposed and its contents need to be drawn again
+	mRenderThread->RequestFrame();
 }
 
 //------------------------------------------------------------------------------
 void CanvasWidget::resizeEvent(QResizeEvent* /*event*/)
 {
-	mRenderDevice->Resize(width(), height());
+	mRenderThread->Resize(width(), height());
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::wheelEvent(QWheelEvent* event)
+{
+	// Zoom around the cursor, 10% per wheel notch
+	double worldX = 0.0;
+	double worldY = 0.0;
+	const QPointF position = event->position();
+	mCamera.ScreenToWorld(position.x(), position.y(), width(), height(), worldX, worldY);
+	mCamera.ZoomAt(std::pow(1.1, event->angleDelta().y() / 120.0), worldX, worldY);
+	mRenderThread->SetCamera(mCamera);
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::mousePressEvent(QMouseEvent* event)
+{
+	if (event->button() == Qt::LeftButton)
+	{
+		mPanning = true;
+		mLastMousePosition = event->position();
+	}
+}
+
+//------------------------------------------------------------------------------
+void CanvasWidget::mouseMoveEvent(QMouseEvent* event)
+{
+	if (!mPanning)
+	{
+		return;
+	}
+
+	// Keep the world point under the cursor fixed while dragging
+	double lastX = 0.0;
+	double lastY = 0.0;
+	double currentX = 0.0;
+	double currentY = 0.0;
+	const QPointF position = event->position();
+	mCamera.ScreenToWorld(mLastMousePosition.x(), mLastMousePosition.y(), width(), height(), lastX, lastY);
+	mCamera.ScreenToWorld(position.x(), position.y(), width(), height(), currentX, currentY);
+	mCamera.Pan(lastX - currentX, lastY - currentY);
+	mRenderThread->SetCamera(mCamera);
+
+	mLastMousePosition = position;
 }
 
 //------------------------------------------------------------------------------
-void CanvasWidget::Update()
+void CanvasWidget::mouseReleaseEvent(QMouseEvent* event)
 {
-	mVectorRenderer->Render();
-	update();
+	if (event->button() == Qt::LeftButton)
+	{
+		mPanning = false;
+	}
 }
@@ -1,16 +1,17 @@
 #pragma once
 
 // Renderer
+#include <Renderer/Camera.h>
 #include <Renderer/RendererFactory.h>
+#include <Renderer/RenderThread.h>
+#include <Renderer/ShapeHandle.h>
 
 // External
+#include <QPointF>
 #include <QWidget>
 
 //------------------------------------------------------------------------------
-class IRenderDevice;
 class IVectorShape;
-class QTimer;
-class VectorRenderer;
 
 //------------------------------------------------------------------------------
 class CanvasWidget : public QWidget
@@ -21,19 +22,52 @@ public:
 	CanvasWidget(GraphicsBackend backend, QWidget* parent = nullptr);
 	~CanvasWidget();
 
-	void AddShape(IVectorShape* shape);
+	// Shapes are handed to the render thread, they must be set up before they are added
+	ShapeHandle AddShape(IVectorShape* shape);
+	void AddRects(const VectorRenderer::RectParams* rects, size_t count, ShapeHandle* handles = nullptr);
+	void AddLines(const VectorRenderer::LineParams* lines, size_t count, ShapeHandle* handles = nullptr);
+	void AddBezierCurves(const VectorRenderer::BezierCurveParams* curves, size_t count, ShapeHandle* handles = nullptr);
+	void AddCubicBezierCurves(const VectorRenderer::CubicBezierCurveParams* curves, size_t count, ShapeHandle* handles = nullptr);
+
+	void UpdateShape(ShapeHandle handle, IVectorShape* shape);
+	void RemoveShape(ShapeHandle handle);
+	void RestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill);
 	void ClearShapes();
 
+	GroupHandle AddGroup(GroupHandle parent = GroupHandle());
+	void SetGroupTransform(GroupHandle group, const Transform& transform);
+	void RemoveGroup(GroupHandle group);
+	void SetShapeGroup(ShapeHandle shape, GroupHandle group);
+
+	// Changes recorded into a batch show up together in the same frame
+	RenderThread::Batch BeginBatch();
+	void SubmitBatch(RenderThread::Batch& batch);
+
+	// Shows a version of a Scene instead of the shapes added above
+	void PresentScene(const SceneSnapshot& scene);
+
+	// Renders only when something changes unless a rate is given, for animations
+	void SetContinuousRendering(double framesPerSecond);
+
+	FrameStats GetFrameStats() const;
+
 protected:
+	virtual void paintEvent(QPaintEvent* event) override;
 	virtual void resizeEvent(QResizeEvent* event) override;
+	virtual void wheelEvent(QWheelEvent* event) override;
+	virtual void mousePressEvent(QMouseEvent* event) override;
+	virtual void mouseMoveEvent(QMouseEvent* event) override;
+	virtual void mouseReleaseEvent(QMouseEvent* event) override;
 	virtual QPaintEngine* paintEngine() const override { return nullptr; }
 
-private slots:
-	void Update();
-
 private:
-	QTimer* mTimer = nullptr;
-	IRenderDevice* mRenderDevice = nullptr;
-	VectorRenderer* mVectorRenderer = nullptr;
+	RenderThread* mRenderThread = nullptr;
+
+	// Navigated here and posted to the render thread after every change
+	Camera mCamera;
+
+	// Left-drag panning
+	bool mPanning = false;
+	QPointF mLastMousePosition;
 };
 
@@ -8,9 +8,15 @@
 // Vector
 #include <Vector/VectorShape.h>
 
+// Utils
+#include <Utils/Config.h>
+
 // External
 #include <QIcon>
 
+// System
+#include <cmath>
+
 //------------------------------------------------------------------------------
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
@@ -41,24 +47,51 @@ MainWindow::~MainWindow()
 void MainWindow::CreateTestShapes()
 {
     // Create a line
-    Line* line = new Line(960.0f, 540.0f, 1920.0f, 1080.0f);
-    line->SetStroke(1.0f, 0.0f, 0.0f, 1.0f, 5.0f);
+    VectorRenderer::LineParams line = { 960.0, 540.0, 1920.0, 1080.0, { 1.0f, 0.0f, 0.0f, 1.0f }, 5.0f };
+    mCanvas->AddLines(&line, 1);
 
     // Create a rectangle
-    Rect* rect = new Rect(0.0f, 0.0f, 960.0f, 540.0f);
-    rect->SetFill(1.0f, 1.0f, 1.0f, 1.0f);
+    VectorRenderer::RectParams rect = { 0.0, 0.0, 960.0, 540.0, { 1.0f, 1.0f, 1.0f, 1.0f } };
+    mCanvas->AddRects(&rect, 1);
 
     // Create a quadratic Bezier curve
-    BezierCurve* quadCurve = new BezierCurve(960.0f, 540.0f, 0.0f, 1080.0f, 480.0f, 1010.0f);
-    quadCurve->SetStroke(0.0f, 1.0f, 0.0f, 1.0f, 5.0f);
+    VectorRenderer::BezierCurveParams quadCurve = { 960.0, 540.0, 0.0, 1080.0, 480.0, 1010.0, { 0.0f, 1.0f, 0.0f, 1.0f }, 5.0f };
+    mCanvas->AddBezierCurves(&quadCurve, 1);
 
     // Create a cubic Bezier curve
-    CubicBezierCurve* cubicCurve = new CubicBezierCurve(960.0f, 540.0f, 1920.0f, 0.0f, 1200.0f, 205.0f, 1440.0f, 335.0f);
-    cubicCurve->SetStroke(0.0f, 0.0f, 1.0f, 1.0f, 5.0f);
-
-    // Add shapes to the renderer
-    mCanvas->AddShape(line);
-    mCanvas->AddShape(rect);
-    mCanvas->AddShape(quadCurve);
-    mCanvas->AddShape(cubicCurve);
+    VectorRenderer::CubicBezierCurveParams cubicCurve = { 960.0, 540.0, 1920.0, 0.0, 1200.0, 205.0, 1440.0, 335.0, { 0.0f, 0.0f, 1.0f, 1.0f }, 5.0f };
+    mCanvas->AddCubicBezierCurves(&cubicCurve, 1);
+
+#if STRESS_SCENE
+    CreateStressShapes();
+#endif
+}
+
+// Large data sets for profiling, kept out of the demo scene
+//------------------------------------------------------------------------------
+void MainWindow::CreateStressShapes()
+{
+    // Create a dense time series
+    PolyLine* series = new PolyLine();
+    series->points.resize(1000000);
+    for (size_t i = 0; i < series->points.size(); ++i)
+    {
+        const float t = static_cast<float>(i) / series->points.size();
+        series->points[i].x = t * 1920.0f;
+        series->points[i].y = 810.0f + std::sin(t * 60.0f) * 100.0f + std::sin(t * 7919.0f) * 20.0f;
+    }
+    series->SetStroke(1.0f, 1.0f, 0.0f, 1.0f, 2.0f);
+
+    // Create a scatter plot
+    PointCloud* scatter = new PointCloud(MarkerShape::Circle);
+    scatter->markers.reserve(100000);
+    for (int32_t i = 0; i < 100000; ++i)
+    {
+        const float t = static_cast<float>(i) / 100000.0f;
+        scatter->AddMarker(1440.0f + std::cos(t * 6283.0f) * t * 400.0f, 810.0f + std::sin(t * 6283.0f) * t * 250.0f, 4.0f, t, 0.5f, 1.0f - t, 0.75f);
+    }
+
+    // Hand the finished shapes to the renderer
+    mCanvas->AddShape(series);
+    mCanvas->AddShape(scatter);
 }
@@ -20,6 +20,7 @@ public:
 
 private:
     void CreateTestShapes();
+    void CreateStressShapes();
 
     Ui::VectorRendererClass mUI;
     CanvasWidget* mCanvas = nullptr;
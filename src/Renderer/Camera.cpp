@@ -0,0 +1,164 @@
+#include "Camera.h"
+
+// System
+#include <cmath>
+
+//------------------------------------------------------------------------------
+void Camera::SetCenter(double x, double y)
+{
+	mCenterX = x;
+	mCenterY = y;
+}
+
+//------------------------------------------------------------------------------
+void Camera::SetZoom(double zoom)
+{
+	mZoom = zoom;
+}
+
+//------------------------------------------------------------------------------
+void Camera::SetRotation(double radians)
+{
+	mRotation = radians;
+	mCos = std::cos(radians);
+	mSin = std::sin(radians);
+}
+
+//------------------------------------------------------------------------------
+void Camera::Reset()
+{
+	*this = Camera();
+}
+
+//------------------------------------------------------------------------------
+void Camera::Pan(double dx, double dy)
+{
+	mCenterX += dx;
+	mCenterY += dy;
+}
+
+//------------------------------------------------------------------------------
+void Camera::ZoomAt(double factor, double worldX, double worldY)
+{
+	// The point's offset from the center shrinks by the same factor the zoom grows
+	mCenterX = worldX + (mCenterX - worldX) / factor;
+	mCenterY = worldY + (mCenterY - worldY) / factor;
+	mZoom *= factor;
+}
+
+//------------------------------------------------------------------------------
+int32_t Camera::GetZoomLevel() const
+{
+	return static_cast<int32_t>(std::floor(std::log2(mZoom)));
+}
+
+//------------------------------------------------------------------------------
+void Camera::GetOrigin(double& x, double& y) const
+{
+	// Power of two at least as large as the visible extent
+	const double extent = AUTHORED_WIDTH / mZoom;
+	const double grid = std::exp2(std::ceil(std::log2(extent)));
+
+	x = std::floor(mCenterX / grid + 0.5) * grid;
+	y = std::floor(mCenterY / grid + 0.5) * grid;
+}
+
+//------------------------------------------------------------------------------
+Eigen::Matrix4f Camera::GetViewProjection(double originX, double originY) const
+{
+	using namespace Eigen;
+
+	// Translate the center to the origin, rotate, then scale so the authored canvas spans -1 to 1
+	// (flipping y since authored space is top-down). The translation is the only large term, so it is
+	// resolved in double against the origin before dropping to float
+	const double scaleX = 2.0 * mZoom / AUTHORED_WIDTH;
+	const double scaleY = -2.0 * mZoom / AUTHORED_HEIGHT;
+	const double centerX = mCenterX - originX;
+	const double centerY = mCenterY - originY;
+
+	Matrix4f viewProjection = Matrix4f::Identity();
+	viewProjection(0, 0) = static_cast<float>(scaleX * mCos);
+	viewProjection(0, 1) = static_cast<float>(-scaleX * mSin);
+	viewProjection(0, 3) = static_cast<float>(-scaleX * (mCos * centerX - mSin * centerY));
+	viewProjection(1, 0) = static_cast<float>(scaleY * mSin);
+	viewProjection(1, 1) = static_cast<float>(scaleY * mCos);
+	viewProjection(1, 3) = static_cast<float>(-scaleY * (mSin * centerX + mCos * centerY));
+	return viewProjection;
+}
+
+//------------------------------------------------------------------------------
+Eigen::Matrix4f Camera::GetViewProjection() const
+{
+	double originX = 0.0;
+	double originY = 0.0;
+	GetOrigin(originX, originY);
+	return GetViewProjection(originX, originY);
+}
+
+//------------------------------------------------------------------------------
+void Camera::WorldToScreen(double x, double y, float width, float height, float& screenX, float& screenY) const
+{
+	const double dx = x - mCenterX;
+	const double dy = y - mCenterY;
+	const double viewX = (mCos * dx - mSin * dy) * mZoom;
+	const double viewY = (mSin * dx + mCos * dy) * mZoom;
+
+	screenX = static_cast<float>(viewX * (width / AUTHORED_WIDTH) + width * 0.5);
+	screenY = static_cast<float>(viewY * (height / AUTHORED_HEIGHT) + height * 0.5);
+}
+
+//------------------------------------------------------------------------------
+void Camera::ScreenToWorld(float screenX, float screenY, float width, float height, double& x, double& y) const
+{
+	const double viewX = (screenX - width * 0.5) * (AUTHORED_WIDTH / static_cast<double>(width)) / mZoom;
+	const double viewY = (screenY - height * 0.5) * (AUTHORED_HEIGHT / static_cast<double>(height)) / mZoom;
+
+	// Inverse rotation
+	x = mCos * viewX + mSin * viewY + mCenterX;
+	y = -mSin * viewX + mCos * viewY + mCenterY;
+}
+
+//------------------------------------------------------------------------------
+Bounds Camera::GetVisibleBounds() const
+{
+	// The viewport always shows an authored-size window scaled by the zoom, independent of its pixel size
+	const float corners[][2] =
+	{
+		{ 0.0f, 0.0f },
+		{ static_cast<float>(AUTHORED_WIDTH), 0.0f },
+		{ 0.0f, static_cast<float>(AUTHORED_HEIGHT) },
+		{ static_cast<float>(AUTHORED_WIDTH), static_cast<float>(AUTHORED_HEIGHT) }
+	};
+
+	Bounds bounds;
+	for (const auto& corner : corners)
+	{
+		double x = 0.0;
+		double y = 0.0;
+		ScreenToWorld(corner[0], corner[1], static_cast<float>(AUTHORED_WIDTH), static_cast<float>(AUTHORED_HEIGHT), x, y);
+		bounds.Add(x, y);
+	}
+	return bounds;
+}
+
+//------------------------------------------------------------------------------
+Camera Camera::GetLocalCamera(const Transform& transform) const
+{
+	// The world center seen from the local space, with the transform's scale and rotation folded into the view
+	Camera camera;
+	camera.mCenterX = mCenterX;
+	camera.mCenterY = mCenterY;
+	transform.ApplyInverse(camera.mCenterX, camera.mCenterY);
+	camera.mZoom = mZoom * transform.scale;
+	camera.SetRotation(mRotation + transform.rotation);
+	return camera;
+}
+
+//------------------------------------------------------------------------------
+bool Camera::operator==(const Camera& other) const
+{
+	return mCenterX == other.mCenterX
+		&& mCenterY == other.mCenterY
+		&& mZoom == other.mZoom
+		&& mRotation == other.mRotation;
+}
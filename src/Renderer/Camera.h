@@ -0,0 +1,80 @@
+#pragma once
+
+// Utils
+#include <Utils/Bounds.h>
+#include <Utils/Config.h>
+#include <Utils/Transform.h>
+
+// External
+#include <External/Eigen/Dense>
+
+// View onto authored (world) space. Geometry stays in world space and the camera is applied by the device
+// through the view-projection constant, so navigating only re-tessellates when the render origin moves.
+// At zoom 1 with no rotation the authored canvas fills the viewport, as before cameras existed.
+//
+// World positions are doubles so deep zooms stay precise. Vertices are floats relative to an origin
+// (the camera's render origin, or a batch's own origin) and the view-projection is built in double
+// relative to that origin, so the float math only ever sees small numbers.
+//------------------------------------------------------------------------------
+class Camera
+{
+public:
+	Camera() = default;
+
+	void SetCenter(double x, double y);
+	void SetZoom(double zoom);
+	void SetRotation(double radians);
+	void Reset();
+
+	// Moves the center by a world-space offset
+	void Pan(double dx, double dy);
+
+	// Scales the zoom while keeping the given world point fixed on screen
+	void ZoomAt(double factor, double worldX, double worldY);
+
+	double GetCenterX() const { return mCenterX; }
+	double GetCenterY() const { return mCenterY; }
+	double GetZoom() const { return mZoom; }
+	double GetRotation() const { return mRotation; }
+
+	// Horizontal pixels per world unit for a viewport of the given width
+	double GetPixelsPerUnit(float width) const { return width / AUTHORED_WIDTH * mZoom; }
+
+	// Zoom octave, detail that depends on the zoom only needs rebuilding when this changes
+	int32_t GetZoomLevel() const;
+
+	// World axes map to screen axes, so axis-aligned shapes stay axis-aligned
+	bool IsAxisAligned() const { return mRotation == 0.0; }
+
+	// Origin that tessellated vertices are relative to. It is snapped to a grid sized to the visible extent,
+	// so it stays put while panning within a few screens and only moves on large pans or zoom steps
+	void GetOrigin(double& x, double& y) const;
+
+	// Origin-relative positions to clip space
+	Eigen::Matrix4f GetViewProjection(double originX, double originY) const;
+	Eigen::Matrix4f GetViewProjection() const;
+
+	// World to pixels and back for a viewport of the given size, pixel (0, 0) is the top-left corner
+	void WorldToScreen(double x, double y, float width, float height, float& screenX, float& screenY) const;
+	void ScreenToWorld(float screenX, float screenY, float width, float height, double& x, double& y) const;
+
+	// World-space box containing everything the viewport can show
+	Bounds GetVisibleBounds() const;
+
+	// Sees the space a transform places into world space the way this camera sees world space, so geometry in
+	// that space is drawn with the transform applied
+	Camera GetLocalCamera(const Transform& transform) const;
+
+	bool operator==(const Camera& other) const;
+	bool operator!=(const Camera& other) const { return !(*this == other); }
+
+private:
+	double mCenterX = AUTHORED_WIDTH * 0.5;
+	double mCenterY = AUTHORED_HEIGHT * 0.5;
+	double mZoom = 1.0;
+	double mRotation = 0.0;
+
+	// Cached from mRotation
+	double mCos = 1.0;
+	double mSin = 0.0;
+};
@@ -9,12 +9,28 @@
 #include <External/Eigen/Geometry>
 #include <QDebug>
 
+// System
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 //------------------------------------------------------------------------------
 struct ConstantBuffer
 {
 	Eigen::Matrix4f worldViewProj;
 };
 
+// Corresponds to the Markers cbuffer in MarkerVertexShader/MarkerPixelShader
+//------------------------------------------------------------------------------
+struct MarkerConstantBuffer
+{
+	float authoredSize[2];
+	float viewportSize[2];
+	uint32_t shape;
+	float zoom;
+	float rotation[2];
+};
+
 //------------------------------------------------------------------------------
 #define RELEASE(x) if ((x)) { (x)->Release(); (x) = nullptr; }
 
@@ -84,6 +100,24 @@ DirectXRenderDevice::~DirectXRenderDevice()
 	}
 	mDeviceContext->RSSetState(mRasterizerState);
 
+	// Setup blend state, straight alpha so translucent shapes and anti-aliased marker edges composite
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.RenderTarget[0].BlendEnable = TRUE;
+	blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	hr = mDevice->CreateBlendState(&blendDesc, &mBlendState);
+	if (FAILED(hr))
+	{
+		ASSERT(false, "Failed to create blend state");
+		return false;
+	}
+	mDeviceContext->OMSetBlendState(mBlendState, nullptr, 0xFFFFFFFFu);
+
 	// Create render target view
 	ID3D11Texture2D* backBuffer = nullptr;
 	hr = mSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&backBuffer));
@@ -163,22 +197,50 @@ DirectXRenderDevice::~DirectXRenderDevice()
 	RELEASE(mPixelShader);
 	RELEASE(mVertexBuffer);
 	RELEASE(mIndexBuffer);
+	RELEASE(mConstantBuffer);
+	mVertexBufferCapacity = 0;
+	mIndexBufferCapacity = 0;
+	mVertexBufferBound = false;
+	mIndexBufferBound = false;
+	mConstantBufferBound = false;
+	RELEASE(mStyleView);
+	RELEASE(mStyleBuffer);
+	mStyleCapacity = 0;
 	RELEASE(mInputLayout);
+	RELEASE(mMarkerVertexShader);
+	RELEASE(mMarkerPixelShader);
+	RELEASE(mMarkerCornerBuffer);
+	RELEASE(mMarkerInstanceBuffer);
+	RELEASE(mMarkerConstantBuffer);
+	RELEASE(mMarkerInputLayout);
+	mMarkerInstanceCapacity = 0;
+	RELEASE(mBlendState);
 	RELEASE(mRasterizerState);
 	RELEASE(mSwapChain);
 	RELEASE(mDeviceContext);
 	RELEASE(mDevice);
 }
 
+//------------------------------------------------------------------------------
+/*virtual*/ void DirectXRenderDevice::SetCamera(const Camera& camera)
+{
+	if (camera != mCamera)
+	{
+		mCamera = camera;
+		mConstantBufferDirty = true;
+	}
+}
+
+//------------------------------------------------------------------------------
 /*virtual*/ bool DirectXRenderDevice::LoadShaders()
 {
-	ID3DBlob* vertexShaderBlob = LoadVertexShader(kShadersDir + L"VertexShader.hlsl", "main");
+	ID3DBlob* vertexShaderBlob = LoadVertexShader(kShadersDir + L"VertexShader.hlsl", "main", &mVertexShader);
 	if (vertexShaderBlob == nullptr)
 	{
 		return false;
 	}
 
-	ID3DBlob* pixelShaderBlob = LoadPixelShader(kShadersDir + L"PixelShader.hlsl", "main");
+	ID3DBlob* pixelShaderBlob = LoadPixelShader(kShadersDir + L"PixelShader.hlsl", "main", &mPixelShader);
 	if (pixelShaderBlob == nullptr)
 	{
 		return false;
@@ -189,112 +251,402 @@ DirectXRenderDevice::~DirectXRenderDevice()
 	vertexShaderBlob->Release();
 	pixelShaderBlob->Release();
 
+	// Instanced markers
+	ID3DBlob* markerVertexShaderBlob = LoadVertexShader(kShadersDir + L"MarkerVertexShader.hlsl", "main", &mMarkerVertexShader);
+	if (markerVertexShaderBlob == nullptr)
+	{
+		return false;
+	}
+
+	ID3DBlob* markerPixelShaderBlob = LoadPixelShader(kShadersDir + L"MarkerPixelShader.hlsl", "main", &mMarkerPixelShader);
+	if (markerPixelShaderBlob == nullptr)
+	{
+		markerVertexShaderBlob->Release();
+		return false;
+	}
+
+	SetMarkerInputLayout(markerVertexShaderBlob);
+
+	markerVertexShaderBlob->Release();
+	markerPixelShaderBlob->Release();
+
+	if (!CreateMarkerBuffers())
+	{
+		return false;
+	}
+
+	BindTrianglePipeline();
 	return true;
 }
 
 //------------------------------------------------------------------------------
 /*virtual*/ void DirectXRenderDevice::CreateVertexBuffer(const Vertex* vertices, size_t size)
 {
-	D3D11_BUFFER_DESC bufferDesc = {};
-	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	bufferDesc.CPUAccessFlags = 0u;
-	bufferDesc.MiscFlags = 0u;
-	bufferDesc.ByteWidth = static_cast<UINT>(size);
-
-	D3D11_SUBRESOURCE_DATA initData = {};
-	initData.pSysMem = vertices;
-
-	HRESULT hr = mDevice->CreateBuffer(&bufferDesc, &initData, &mVertexBuffer);
-	if (FAILED(hr))
+	if (UpdateDynamicBuffer(D3D11_BIND_VERTEX_BUFFER, vertices, size, &mVertexBuffer, mVertexBufferCapacity))
 	{
-		ASSERT(false, "Failed to create vertex buffer");
+		mVertexBufferBound = false;
 	}
 }
 
 //------------------------------------------------------------------------------
 /*virtual*/ void DirectXRenderDevice::CreateIndexBuffer(const uint16_t* indices, size_t size)
 {
-	D3D11_BUFFER_DESC bufferDesc = {};
-	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	bufferDesc.CPUAccessFlags = 0u;
-	bufferDesc.MiscFlags = 0u;
-	bufferDesc.ByteWidth = static_cast<UINT>(size);
+	if (UpdateDynamicBuffer(D3D11_BIND_INDEX_BUFFER, indices, size, &mIndexBuffer, mIndexBufferCapacity))
+	{
+		mIndexBufferBound = false;
+	}
+}
 
-	D3D11_SUBRESOURCE_DATA initData = {};
-	initData.pSysMem = indices;
+//------------------------------------------------------------------------------
+/*virtual*/ Vertex* DirectXRenderDevice::MapVertexBuffer(size_t size)
+{
+	bool recreated = false;
+	void* data = MapDynamicBuffer(D3D11_BIND_VERTEX_BUFFER, size, &mVertexBuffer, mVertexBufferCapacity, recreated);
+	if (recreated)
+	{
+		mVertexBufferBound = false;
+	}
+	mVertexBufferMapped = data != nullptr;
+	return static_cast<Vertex*>(data);
+}
 
-	HRESULT hr = mDevice->CreateBuffer(&bufferDesc, &initData, &mIndexBuffer);
-	if (FAILED(hr))
+//------------------------------------------------------------------------------
+/*virtual*/ uint16_t* DirectXRenderDevice::MapIndexBuffer(size_t size)
+{
+	bool recreated = false;
+	void* data = MapDynamicBuffer(D3D11_BIND_INDEX_BUFFER, size, &mIndexBuffer, mIndexBufferCapacity, recreated);
+	if (recreated)
 	{
-		ASSERT(false, "Failed to create index buffer");
+		mIndexBufferBound = false;
+	}
+	mIndexBufferMapped = data != nullptr;
+	return static_cast<uint16_t*>(data);
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void DirectXRenderDevice::UnmapBuffers()
+{
+	if (mVertexBufferMapped)
+	{
+		mDeviceContext->Unmap(mVertexBuffer, 0u);
+		mVertexBufferMapped = false;
+	}
+	if (mIndexBufferMapped)
+	{
+		mDeviceContext->Unmap(mIndexBuffer, 0u);
+		mIndexBufferMapped = false;
 	}
 }
 
 //------------------------------------------------------------------------------
 /*virtual*/ void DirectXRenderDevice::SetVertexBuffer()
 {
+	// The buffers outlive the draws, so binding them again is only needed after they grow or the markers took slot 0
+	if (mVertexBufferBound)
+	{
+		return;
+	}
+
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 	mDeviceContext->IASetVertexBuffers(0u, 1u, &mVertexBuffer, &stride, &offset);
+	mVertexBufferBound = true;
 }
 
 //------------------------------------------------------------------------------
 /*virtual*/ void DirectXRenderDevice::SetIndexBuffer()
 {
+	if (mIndexBufferBound)
+	{
+		return;
+	}
+
 	mDeviceContext->IASetIndexBuffer(mIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+	mIndexBufferBound = true;
 }
 
 //------------------------------------------------------------------------------
 /*virtrual*/ void DirectXRenderDevice::SetConstantBuffers()
 {
-	using namespace Eigen;
+	// Retained meshes are tessellated relative to the camera's render origin
+	double originX = 0.0;
+	double originY = 0.0;
+	mCamera.GetOrigin(originX, originY);
+	UpdateConstantBuffer(originX, originY);
+}
 
-	const float left = -1.0f;
-	const float right = 1.0f;
-	const float top = -1.0f;
-	const float bottom = 1.0f;
+//------------------------------------------------------------------------------
+void DirectXRenderDevice::UpdateConstantBuffer(double originX, double originY)
+{
+	if (mConstantBuffer == nullptr)
+	{
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		bufferDesc.CPUAccessFlags = 0u;
+		bufferDesc.MiscFlags = 0u;
+		bufferDesc.ByteWidth = sizeof(ConstantBuffer);
+
+		HRESULT hr = mDevice->CreateBuffer(&bufferDesc, nullptr, &mConstantBuffer);
+		if (FAILED(hr))
+		{
+			ASSERT(false, "Failed to create constant buffer");
+			return;
+		}
+		mConstantBufferDirty = true;
+		mConstantBufferBound = false;
+	}
 
-	Matrix4f projection = Matrix4f::Identity();
-	projection(0, 0) = 2.0f / (right - left);
-	projection(1, 1) = 2.0f / (top - bottom);
-	projection(0, 3) = -(right + left) / (right - left);
-	projection(1, 3) = -(top + bottom) / (top - bottom);
+	// Only the camera and origin live in here, so this is rewritten once per frame plus once per marker batch
+	if (mConstantBufferDirty || originX != mConstantBufferOriginX || originY != mConstantBufferOriginY)
+	{
+		ConstantBuffer cb;
+		cb.worldViewProj = mCamera.GetViewProjection(originX, originY);
+		mDeviceContext->UpdateSubresource(mConstantBuffer, 0u, nullptr, &cb, 0u, 0u);
+		mConstantBufferOriginX = originX;
+		mConstantBufferOriginY = originY;
+		mConstantBufferDirty = false;
+	}
 
-	// Create constant buffer
-	ConstantBuffer cb;
-	cb.worldViewProj = projection.inverse();
+	// Slot 0 is never taken by anything else
+	if (!mConstantBufferBound)
+	{
+		mDeviceContext->VSSetConstantBuffers(0u, 1u, &mConstantBuffer);
+		mConstantBufferBound = true;
+	}
+}
 
-	D3D11_BUFFER_DESC bufferDesc = {};
-	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	bufferDesc.CPUAccessFlags = 0u;
-	bufferDesc.MiscFlags = 0u;
-	bufferDesc.ByteWidth = sizeof(ConstantBuffer);
+//------------------------------------------------------------------------------
+bool DirectXRenderDevice::UpdateDynamicBuffer(UINT bindFlags, const void* data, size_t size, ID3D11Buffer** buffer, size_t& capacity)
+{
+	bool recreated = false;
+	void* mapped = MapDynamicBuffer(bindFlags, size, buffer, capacity, recreated);
+	if (mapped != nullptr)
+	{
+		memcpy(mapped, data, size);
+		mDeviceContext->Unmap(*buffer, 0u);
+	}
+	return recreated;
+}
 
-	D3D11_SUBRESOURCE_DATA initData = {};
-	initData.pSysMem = &cb;
+//------------------------------------------------------------------------------
+void* DirectXRenderDevice::MapDynamicBuffer(UINT bindFlags, size_t size, ID3D11Buffer** buffer, size_t& capacity, bool& recreated)
+{
+	if (size == 0)
+	{
+		return nullptr;
+	}
 
-	ID3D11Buffer* constantBuffer = nullptr;
-	HRESULT hr = mDevice->CreateBuffer(&bufferDesc, &initData, &constantBuffer);
+	// Grow geometrically, a buffer that is big enough is rewritten in place and stays bound
+	if (size > capacity)
+	{
+		const size_t newCapacity = std::max(size, capacity * 2);
+		RELEASE(*buffer);
+		capacity = 0;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags = bindFlags;
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0u;
+		bufferDesc.ByteWidth = static_cast<UINT>(newCapacity);
+
+		recreated = true;
+		HRESULT hr = mDevice->CreateBuffer(&bufferDesc, nullptr, buffer);
+		if (FAILED(hr))
+		{
+			ASSERT(false, "Failed to create dynamic buffer");
+			return nullptr;
+		}
+		capacity = newCapacity;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	HRESULT hr = mDeviceContext->Map(*buffer, 0u, D3D11_MAP_WRITE_DISCARD, 0u, &mapped);
 	if (FAILED(hr))
 	{
-		ASSERT(false, "Failed to create constant buffer");
+		ASSERT(false, "Failed to map dynamic buffer");
+		return nullptr;
 	}
+	return mapped.pData;
+}
 
-	mDeviceContext->VSSetConstantBuffers(0u, 1u, &constantBuffer);
+//------------------------------------------------------------------------------
+/*virtual*/ void DirectXRenderDevice::SetStyles(const Style* styles, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
 
-	constantBuffer->Release();
+	// Grow geometrically, the view covers the whole buffer so it is recreated along with it
+	if (count > mStyleCapacity)
+	{
+		const size_t capacity = std::max(count, mStyleCapacity * 2);
+		RELEASE(mStyleView);
+		RELEASE(mStyleBuffer);
+		mStyleCapacity = 0;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0u;
+		bufferDesc.ByteWidth = static_cast<UINT>(capacity * sizeof(Style));
+
+		HRESULT hr = mDevice->CreateBuffer(&bufferDesc, nullptr, &mStyleBuffer);
+		if (FAILED(hr))
+		{
+			ASSERT(false, "Failed to create style buffer");
+			return;
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+		viewDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		viewDesc.Buffer.FirstElement = 0u;
+		viewDesc.Buffer.NumElements = static_cast<UINT>(capacity);
+
+		hr = mDevice->CreateShaderResourceView(mStyleBuffer, &viewDesc, &mStyleView);
+		if (FAILED(hr))
+		{
+			ASSERT(false, "Failed to create style buffer view");
+			RELEASE(mStyleBuffer);
+			return;
+		}
+		mStyleCapacity = capacity;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	HRESULT hr = mDeviceContext->Map(mStyleBuffer, 0u, D3D11_MAP_WRITE_DISCARD, 0u, &mapped);
+	if (FAILED(hr))
+	{
+		ASSERT(false, "Failed to map style buffer");
+		return;
+	}
+	memcpy(mapped.pData, styles, count * sizeof(Style));
+	mDeviceContext->Unmap(mStyleBuffer, 0u);
+
+	// Only the triangle pipeline reads it, the marker shaders don't touch t0
+	mDeviceContext->VSSetShaderResources(0u, 1u, &mStyleView);
 }
 
 //------------------------------------------------------------------------------
-/*virtual*/ void DirectXRenderDevice::DrawIndexedTriangles(size_t indexCount)
+/*virtual*/ void DirectXRenderDevice::DrawIndexedTriangles(size_t indexCount, PrimitiveTopology topology)
 {
-	mDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	if (mMarkerPipelineBound)
+	{
+		BindTrianglePipeline();
+	}
+
+	// Strip cuts are always on for strip topologies, 0xFFFF with 16-bit indices
+	mDeviceContext->IASetPrimitiveTopology(topology == PrimitiveTopology::TriangleStrip ? D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	mDeviceContext->DrawIndexed(static_cast<UINT>(indexCount), 0, 0);
 }
 
+//------------------------------------------------------------------------------
+/*virtual*/ bool DirectXRenderDevice::HasDirectRects() const
+{
+	// Triangle setup is cheap on the GPU, rects go through the regular indexed path
+	return false;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool DirectXRenderDevice::HasDirectHairlines() const
+{
+	return false;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool DirectXRenderDevice::HasDirectMarkers() const
+{
+	return mMarkerVertexShader != nullptr && mMarkerPixelShader != nullptr;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool DirectXRenderDevice::FillRect(double x, double y, double width, double height, float r, float g, float b, float a)
+{
+	// Triangle setup is cheap on the GPU, rects go through the regular indexed path
+	return false;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool DirectXRenderDevice::DrawHairline(double x1, double y1, double x2, double y2, float width, float r, float g, float b, float a)
+{
+	return false;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool DirectXRenderDevice::DrawMarkers(const Marker* markers, size_t count, MarkerShape shape, double originX, double originY)
+{
+	if (mMarkerVertexShader == nullptr || mMarkerPixelShader == nullptr)
+	{
+		return false;
+	}
+
+	if (count == 0)
+	{
+		return true;
+	}
+
+	// Grow the instance buffer geometrically so steadily growing clouds don't reallocate every frame
+	if (count > mMarkerInstanceCapacity)
+	{
+		const size_t capacity = std::max(count, mMarkerInstanceCapacity * 2);
+		RELEASE(mMarkerInstanceBuffer);
+		mMarkerInstanceCapacity = 0;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0u;
+		bufferDesc.ByteWidth = static_cast<UINT>(capacity * sizeof(Marker));
+
+		HRESULT hr = mDevice->CreateBuffer(&bufferDesc, nullptr, &mMarkerInstanceBuffer);
+		if (FAILED(hr))
+		{
+			ASSERT(false, "Failed to create marker instance buffer");
+			return false;
+		}
+		mMarkerInstanceCapacity = capacity;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	HRESULT hr = mDeviceContext->Map(mMarkerInstanceBuffer, 0u, D3D11_MAP_WRITE_DISCARD, 0u, &mapped);
+	if (FAILED(hr))
+	{
+		ASSERT(false, "Failed to map marker instance buffer");
+		return false;
+	}
+	memcpy(mapped.pData, markers, count * sizeof(Marker));
+	mDeviceContext->Unmap(mMarkerInstanceBuffer, 0u);
+
+	MarkerConstantBuffer constants = {};
+	constants.authoredSize[0] = static_cast<float>(AUTHORED_WIDTH);
+	constants.authoredSize[1] = static_cast<float>(AUTHORED_HEIGHT);
+	constants.viewportSize[0] = mWidth;
+	constants.viewportSize[1] = mHeight;
+	constants.shape = static_cast<uint32_t>(shape);
+	constants.zoom = mCamera.GetZoom();
+	constants.rotation[0] = static_cast<float>(std::cos(mCamera.GetRotation()));
+	constants.rotation[1] = static_cast<float>(std::sin(mCamera.GetRotation()));
+	mDeviceContext->UpdateSubresource(mMarkerConstantBuffer, 0u, nullptr, &constants, 0u, 0u);
+
+	UpdateConstantBuffer(originX, originY);
+	BindMarkerPipeline();
+
+	ID3D11Buffer* buffers[] = { mMarkerCornerBuffer, mMarkerInstanceBuffer };
+	const UINT strides[] = { sizeof(float) * 2, sizeof(Marker) };
+	const UINT offsets[] = { 0u, 0u };
+	mDeviceContext->IASetVertexBuffers(0u, 2u, buffers, strides, offsets);
+	mVertexBufferBound = false;
+	mDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	mDeviceContext->DrawInstanced(4u, static_cast<UINT>(count), 0u, 0u);
+
+	return true;
+}
+
 //------------------------------------------------------------------------------
 void DirectXRenderDevice::UpdateViewport(float width, float height)
 {
@@ -322,7 +674,7 @@ void DirectXRenderDevice::CleanupRenderTarget()
 }
 
 //------------------------------------------------------------------------------
-ID3DBlob* DirectXRenderDevice::LoadVertexShader(const std::wstring& filePath, const std::string& entryPoint)
+ID3DBlob* DirectXRenderDevice::LoadVertexShader(const std::wstring& filePath, const std::string& entryPoint, ID3D11VertexShader** vertexShader)
 {
 	ID3DBlob* vertexShaderBlob = CompileShader(filePath, entryPoint, "vs_5_0");
 	if (vertexShaderBlob == nullptr)
@@ -331,21 +683,20 @@ ID3DBlob* DirectXRenderDevice::LoadVertexShader(const std::wstring& filePath, co
 		return nullptr;
 	}
 
-	HRESULT hr = mDevice->CreateVertexShader(vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), nullptr, &mVertexShader);
+	HRESULT hr = mDevice->CreateVertexShader(vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), nullptr, vertexShader);
 	if (FAILED(hr))
 	{
 		ASSERT(false, "Failed to create vertex shader");
+		vertexShaderBlob->Release();
 		return nullptr;
 	}
 
-	mDeviceContext->VSSetShader(mVertexShader, nullptr, 0);
-
 	// Caller must release blob
 	return vertexShaderBlob;
 }
 
 //------------------------------------------------------------------------------
-ID3DBlob* DirectXRenderDevice::LoadPixelShader(const std::wstring& filePath, const std::string& entryPoint)
+ID3DBlob* DirectXRenderDevice::LoadPixelShader(const std::wstring& filePath, const std::string& entryPoint, ID3D11PixelShader** pixelShader)
 {
 	ID3DBlob* pixelShaderBlob = CompileShader(filePath, entryPoint, "ps_5_0");
 	if (pixelShaderBlob == nullptr)
@@ -354,15 +705,14 @@ ID3DBlob* DirectXRenderDevice::LoadPixelShader(const std::wstring& filePath, con
 		return nullptr;
 	}
 
-	HRESULT hr = mDevice->CreatePixelShader(pixelShaderBlob->GetBufferPointer(), pixelShaderBlob->GetBufferSize(), nullptr, &mPixelShader);
+	HRESULT hr = mDevice->CreatePixelShader(pixelShaderBlob->GetBufferPointer(), pixelShaderBlob->GetBufferSize(), nullptr, pixelShader);
 	if (FAILED(hr))
 	{
 		ASSERT(false, "Failed to create pixel shader");
+		pixelShaderBlob->Release();
 		return nullptr;
 	}
 
-	mDeviceContext->PSSetShader(mPixelShader, nullptr, 0);
-
 	// Caller must release blob
 	return pixelShaderBlob;
 }
@@ -375,7 +725,7 @@ void DirectXRenderDevice::SetInputLayout(ID3DBlob* vertexShaderBlob)
 	const D3D11_INPUT_ELEMENT_DESC layout[] =
 	{
 		{ "POSITION",	0,	DXGI_FORMAT_R32G32B32_FLOAT,	0,	offsetof(Vertex, x),	D3D11_INPUT_PER_VERTEX_DATA,	0 },
-		{ "COLOR",		0,	DXGI_FORMAT_R32G32B32A32_FLOAT,	0,	offsetof(Vertex, r),	D3D11_INPUT_PER_VERTEX_DATA,	0 }
+		{ "STYLE",		0,	DXGI_FORMAT_R32_UINT,			0,	offsetof(Vertex, style),	D3D11_INPUT_PER_VERTEX_DATA,	0 }
 	};
 
 	HRESULT hr = mDevice->CreateInputLayout(layout, ARRAYSIZE(layout), vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), &mInputLayout);
@@ -383,8 +733,91 @@ void DirectXRenderDevice::SetInputLayout(ID3DBlob* vertexShaderBlob)
 	{
 		ASSERT(false, "Failed to create input layout");
 	}
+}
+
+//------------------------------------------------------------------------------
+void DirectXRenderDevice::SetMarkerInputLayout(ID3DBlob* vertexShaderBlob)
+{
+	// Slot 0 is the shared quad corner, slot 1 advances once per marker
+	const D3D11_INPUT_ELEMENT_DESC layout[] =
+	{
+		{ "CORNER",		0,	DXGI_FORMAT_R32G32_FLOAT,		0,	0,						D3D11_INPUT_PER_VERTEX_DATA,	0 },
+		{ "POSITION",	0,	DXGI_FORMAT_R32G32_FLOAT,		1,	offsetof(Marker, x),	D3D11_INPUT_PER_INSTANCE_DATA,	1 },
+		{ "SIZE",		0,	DXGI_FORMAT_R32_FLOAT,			1,	offsetof(Marker, size),	D3D11_INPUT_PER_INSTANCE_DATA,	1 },
+		{ "COLOR",		0,	DXGI_FORMAT_R8G8B8A8_UNORM,		1,	offsetof(Marker, r),	D3D11_INPUT_PER_INSTANCE_DATA,	1 }
+	};
+
+	HRESULT hr = mDevice->CreateInputLayout(layout, ARRAYSIZE(layout), vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), &mMarkerInputLayout);
+	if (FAILED(hr))
+	{
+		ASSERT(false, "Failed to create marker input layout");
+	}
+}
+
+//------------------------------------------------------------------------------
+bool DirectXRenderDevice::CreateMarkerBuffers()
+{
+	// Quad corners in triangle strip order
+	const float corners[] =
+	{
+		-1.0f, -1.0f,
+		 1.0f, -1.0f,
+		-1.0f,  1.0f,
+		 1.0f,  1.0f
+	};
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	bufferDesc.CPUAccessFlags = 0u;
+	bufferDesc.MiscFlags = 0u;
+	bufferDesc.ByteWidth = sizeof(corners);
+
+	D3D11_SUBRESOURCE_DATA initData = {};
+	initData.pSysMem = corners;
+
+	HRESULT hr = mDevice->CreateBuffer(&bufferDesc, &initData, &mMarkerCornerBuffer);
+	if (FAILED(hr))
+	{
+		ASSERT(false, "Failed to create marker corner buffer");
+		return false;
+	}
+
+	bufferDesc = {};
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.CPUAccessFlags = 0u;
+	bufferDesc.MiscFlags = 0u;
+	bufferDesc.ByteWidth = sizeof(MarkerConstantBuffer);
+
+	hr = mDevice->CreateBuffer(&bufferDesc, nullptr, &mMarkerConstantBuffer);
+	if (FAILED(hr))
+	{
+		ASSERT(false, "Failed to create marker constant buffer");
+		return false;
+	}
 
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void DirectXRenderDevice::BindTrianglePipeline()
+{
 	mDeviceContext->IASetInputLayout(mInputLayout);
+	mDeviceContext->VSSetShader(mVertexShader, nullptr, 0);
+	mDeviceContext->PSSetShader(mPixelShader, nullptr, 0);
+	mMarkerPipelineBound = false;
+}
+
+//------------------------------------------------------------------------------
+void DirectXRenderDevice::BindMarkerPipeline()
+{
+	mDeviceContext->IASetInputLayout(mMarkerInputLayout);
+	mDeviceContext->VSSetShader(mMarkerVertexShader, nullptr, 0);
+	mDeviceContext->PSSetShader(mMarkerPixelShader, nullptr, 0);
+	mDeviceContext->VSSetConstantBuffers(1u, 1u, &mMarkerConstantBuffer);
+	mDeviceContext->PSSetConstantBuffers(1u, 1u, &mMarkerConstantBuffer);
+	mMarkerPipelineBound = true;
 }
 
 //------------------------------------------------------------------------------
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Camera.h"
 #include "IRenderDevice.h"
 
 // External
@@ -20,22 +21,45 @@ public:
 	virtual void PreRender() override;
 	virtual void Render() override;
 	virtual void Shutdown() override;
+	virtual int32_t GetWidth() const override { return static_cast<int32_t>(mWidth); }
+	virtual int32_t GetHeight() const override { return static_cast<int32_t>(mHeight); }
+
+	virtual void SetCamera(const Camera& camera) override;
+	virtual const Camera& GetCamera() const override { return mCamera; }
 
 	virtual bool LoadShaders() override;
 
 	virtual void CreateVertexBuffer(const Vertex* vertices, size_t size) override;
 	virtual void CreateIndexBuffer(const uint16_t* indices, size_t size) override;
+	virtual Vertex* MapVertexBuffer(size_t size) override;
+	virtual uint16_t* MapIndexBuffer(size_t size) override;
+	virtual void UnmapBuffers() override;
 	virtual void SetVertexBuffer() override;
 	virtual void SetIndexBuffer() override;
 	virtual void SetConstantBuffers() override;
-	virtual void DrawIndexedTriangles(size_t indexCount) override;
+	virtual void SetStyles(const Style* styles, size_t count) override;
+	virtual void DrawIndexedTriangles(size_t indexCount, PrimitiveTopology topology) override;
+
+	virtual bool HasDirectRects() const override;
+	virtual bool HasDirectHairlines() const override;
+	virtual bool HasDirectMarkers() const override;
+	virtual bool FillRect(double x, double y, double width, double height, float r, float g, float b, float a) override;
+	virtual bool DrawHairline(double x1, double y1, double x2, double y2, float width, float r, float g, float b, float a) override;
+	virtual bool DrawMarkers(const Marker* markers, size_t count, MarkerShape shape, double originX, double originY) override;
 
 private:
 	void UpdateViewport(float width, float height);
+	void UpdateConstantBuffer(double originX, double originY);
+	bool UpdateDynamicBuffer(UINT bindFlags, const void* data, size_t size, ID3D11Buffer** buffer, size_t& capacity);
+	void* MapDynamicBuffer(UINT bindFlags, size_t size, ID3D11Buffer** buffer, size_t& capacity, bool& recreated);
 	void CleanupRenderTarget();
-	ID3DBlob* LoadVertexShader(const std::wstring& filePath, const std::string& entryPoint);
-	ID3DBlob* LoadPixelShader(const std::wstring& filePath, const std::string& entryPoint);
+	ID3DBlob* LoadVertexShader(const std::wstring& filePath, const std::string& entryPoint, ID3D11VertexShader** vertexShader);
+	ID3DBlob* LoadPixelShader(const std::wstring& filePath, const std::string& entryPoint, ID3D11PixelShader** pixelShader);
 	void SetInputLayout(ID3DBlob* vertexShaderBlob);
+	void SetMarkerInputLayout(ID3DBlob* vertexShaderBlob);
+	bool CreateMarkerBuffers();
+	void BindTrianglePipeline();
+	void BindMarkerPipeline();
 	ID3DBlob* CompileShader(const std::wstring& filePath, const std::string& entryPoint, const std::string& target);
 
 	HWND mHWND = 0;
@@ -43,15 +67,46 @@ private:
 	ID3D11DeviceContext* mDeviceContext = nullptr;
 	IDXGISwapChain* mSwapChain = nullptr;
 	ID3D11RasterizerState* mRasterizerState = nullptr;
+	ID3D11BlendState* mBlendState = nullptr;
 	ID3D11RenderTargetView* mRenderTargetView = nullptr;
 
 	ID3D11InputLayout* mInputLayout = nullptr;
 	ID3D11VertexShader* mVertexShader = nullptr;
 	ID3D11PixelShader* mPixelShader = nullptr;
+	ID3D11Buffer* mConstantBuffer = nullptr;
+	bool mConstantBufferDirty = true;
+	bool mConstantBufferBound = false;
+	double mConstantBufferOriginX = 0.0;
+	double mConstantBufferOriginY = 0.0;
+
+	// Style palette, a typed buffer the vertex shader indexes
+	ID3D11Buffer* mStyleBuffer = nullptr;
+	ID3D11ShaderResourceView* mStyleView = nullptr;
+	size_t mStyleCapacity = 0;
+
+	// Mesh buffers, reused while they are big enough so they only need binding again after they grow
 	ID3D11Buffer* mVertexBuffer = nullptr;
 	ID3D11Buffer* mIndexBuffer = nullptr;
+	size_t mVertexBufferCapacity = 0;
+	size_t mIndexBufferCapacity = 0;
+	bool mVertexBufferBound = false;
+	bool mIndexBufferBound = false;
+	bool mVertexBufferMapped = false;
+	bool mIndexBufferMapped = false;
+
+	// Instanced markers
+	ID3D11InputLayout* mMarkerInputLayout = nullptr;
+	ID3D11VertexShader* mMarkerVertexShader = nullptr;
+	ID3D11PixelShader* mMarkerPixelShader = nullptr;
+	ID3D11Buffer* mMarkerCornerBuffer = nullptr;
+	ID3D11Buffer* mMarkerInstanceBuffer = nullptr;
+	ID3D11Buffer* mMarkerConstantBuffer = nullptr;
+	size_t mMarkerInstanceCapacity = 0;
+	bool mMarkerPipelineBound = false;
 
 	float mWidth = 0.0f;
 	float mHeight = 0.0f;
+
+	Camera mCamera;
 };
 
@@ -7,6 +7,9 @@
 #include <stdint.h>
 #include <string>
 
+//------------------------------------------------------------------------------
+class Camera;
+
 //------------------------------------------------------------------------------
 static const std::wstring kShadersDir = L"C:\\Users\\Kijou\\Development\\Graphics\\VectorRenderer\\shaders\\";
 
@@ -14,7 +17,8 @@ static const std::wstring kShadersDir = L"C:\\Users\\Kijou\\Development\\Graphic
 enum class GraphicsBackend
 {
 	DirectX,
-	OpenGL
+	OpenGL,
+	Software
 };
 
 // Corresponds to the input parameters to BasicVertexShader
@@ -22,36 +26,72 @@ enum class GraphicsBackend
 struct Vertex
 {
 	Vertex() = default;
-	Vertex(float x, float y, float z, float r, float g, float b, float a)
+	Vertex(float x, float y, float z, uint32_t style)
 		: x(x)
 		, y(y)
 		, z(z)
-		, r(r)
-		, g(g)
-		, b(b)
-		, a(a)
-	{
-	}
-
-	void Normalize()
+		, style(style)
 	{
-		// Translate to origin being top-left and double since NDC is -1 to 1
-		x = ((x * 2.0f) / AUTHORED_WIDTH) - 1.0f;
-		y = ((y * 2.0f) / AUTHORED_HEIGHT) - 1.0f;
 	}
 
-	// Position
+	// Position, relative to the render origin in authored (world) units
 	float x = 0.0f;
-	float y = 0.0f;;
+	float y = 0.0f;
 	float z = 0.0f;
 
-	// Color
+	// Index into the style palette, so recoloring doesn't touch the vertices
+	uint32_t style = 0;
+};
+
+static_assert(sizeof(Vertex) == 16, "Vertex must match the input layout");
+
+// Style palette entry. Corresponds to the Styles buffer in VertexShader
+//------------------------------------------------------------------------------
+struct Style
+{
 	float r = 0.0f;
 	float g = 0.0f;
 	float b = 0.0f;
 	float a = 0.0f;
 };
 
+//------------------------------------------------------------------------------
+enum class PrimitiveTopology
+{
+	TriangleList,
+	TriangleStrip		// Restarted by kStripRestartIndex
+};
+
+// Ends the current strip so several strips can share one draw, the value D3D uses for 16-bit indices
+//------------------------------------------------------------------------------
+static const uint16_t kStripRestartIndex = 0xFFFF;
+
+//------------------------------------------------------------------------------
+enum class MarkerShape
+{
+	Circle,
+	Square
+};
+
+// Per-instance marker data, packed to 16 bytes. Corresponds to the instance inputs of MarkerVertexShader
+//------------------------------------------------------------------------------
+struct Marker
+{
+	// Center in authored space
+	float x = 0.0f;
+	float y = 0.0f;
+
+	// Diameter (or side length) in authored space
+	float size = 0.0f;
+
+	// Color
+	uint8_t r = 0;
+	uint8_t g = 0;
+	uint8_t b = 0;
+	uint8_t a = 0;
+};
+static_assert(sizeof(Marker) == 16, "Marker is uploaded as tightly packed instance data");
+
 //------------------------------------------------------------------------------
 class IRenderDevice
 {
@@ -64,16 +104,43 @@ public:
 	virtual void PreRender() = 0;
 	virtual void Render() = 0;
 	virtual void Shutdown() = 0;
+	virtual int32_t GetWidth() const = 0;
+	virtual int32_t GetHeight() const = 0;
+
+	// View
+	virtual void SetCamera(const Camera& camera) = 0;
+	virtual const Camera& GetCamera() const = 0;
 
 	// Resources
 	virtual bool LoadShaders() = 0;
 
-	// Rendering
+	// Rendering, the Set calls may be made before every draw and devices skip the binds that are already in place
 	virtual void CreateVertexBuffer(const Vertex* vertices, size_t size) = 0;
 	virtual void CreateIndexBuffer(const uint16_t* indices, size_t size) = 0;
+
+	// The same buffers written in place rather than copied in, for batches assembled from several meshes. The
+	// pointers stay valid until UnmapBuffers, which comes before the draw. Null if the space couldn't be had.
+	virtual Vertex* MapVertexBuffer(size_t size) = 0;
+	virtual uint16_t* MapIndexBuffer(size_t size) = 0;
+	virtual void UnmapBuffers() = 0;
+
 	virtual void SetVertexBuffer() = 0;
 	virtual void SetIndexBuffer() = 0;
 	virtual void SetConstantBuffers() = 0;
-	virtual void DrawIndexedTriangles(size_t indexCount) = 0;
+	virtual void SetStyles(const Style* styles, size_t count) = 0;
+	virtual void DrawIndexedTriangles(size_t indexCount, PrimitiveTopology topology) = 0;
+
+	// Which of the fast paths below the device has for the current camera. Shapes whose path is missing are
+	// tessellated and batched from the start instead of failing one draw at a time.
+	virtual bool HasDirectRects() const = 0;
+	virtual bool HasDirectHairlines() const = 0;
+	virtual bool HasDirectMarkers() const = 0;
+
+	// Fast paths that bypass tessellation, coordinates are in authored (world) space. Marker positions are float
+	// offsets from the batch origin. These return false if the device has no such path and the caller should
+	// tessellate instead.
+	virtual bool FillRect(double x, double y, double width, double height, float r, float g, float b, float a) = 0;
+	virtual bool DrawHairline(double x1, double y1, double x2, double y2, float width, float r, float g, float b, float a) = 0;
+	virtual bool DrawMarkers(const Marker* markers, size_t count, MarkerShape shape, double originX, double originY) = 0;
 };
 
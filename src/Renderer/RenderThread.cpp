@@ -0,0 +1,492 @@
+#include "RenderThread.h"
+
+// Renderer
+#include <Renderer/IRenderDevice.h>
+
+// Utils
+#include <Utils/Assert.h>
+
+// System
+#include <algorithm>
+#include <utility>
+
+//------------------------------------------------------------------------------
+RenderThread::RenderThread(IRenderDevice* renderDevice, void* windowHandle, int32_t width, int32_t height)
+	: mRenderDevice(renderDevice)
+{
+	mThread = std::thread(&RenderThread::Run, this, windowHandle, width, height);
+}
+
+//------------------------------------------------------------------------------
+RenderThread::~RenderThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mStopping = true;
+	}
+	mWake.notify_one();
+	mThread.join();
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Batch::Batch(Batch&& other)
+	: mOwner(other.mOwner)
+	, mCommands(std::move(other.mCommands))
+{
+	other.mCommands.clear();
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Batch::~Batch()
+{
+	if (!mCommands.empty())
+	{
+		mOwner.Submit(*this);
+	}
+}
+
+//------------------------------------------------------------------------------
+ShapeHandle RenderThread::Batch::AddShape(const IVectorShape* shape)
+{
+	ShapeHandle handle;
+	Push(mOwner.MakeAddShape(shape, handle));
+	return handle;
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Batch::UpdateShape(ShapeHandle handle, const IVectorShape* shape)
+{
+	Push(mOwner.MakeUpdateShape(handle, shape));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Batch::RemoveShape(ShapeHandle handle)
+{
+	Push(mOwner.MakeRemoveShape(handle));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Batch::RestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill)
+{
+	Push(mOwner.MakeRestyleShape(handle, stroke, fill));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Batch::SetGroupTransform(GroupHandle group, const Transform& transform)
+{
+	Push(mOwner.MakeSetGroupTransform(group, transform));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Batch::SetShapeGroup(ShapeHandle shape, GroupHandle group)
+{
+	Push(mOwner.MakeSetShapeGroup(shape, group));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Batch::Push(Command command)
+{
+	if (command)
+	{
+		mCommands.push_back(std::move(command));
+	}
+}
+
+//------------------------------------------------------------------------------
+ShapeHandle RenderThread::AddShape(const IVectorShape* shape)
+{
+	ShapeHandle handle;
+	Post(MakeAddShape(shape, handle));
+	return handle;
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::AddRects(const VectorRenderer::RectParams* rects, size_t count, ShapeHandle* handles)
+{
+	// The caller's arrays may be gone by the time the render thread gets to them
+	AddRects(std::vector<VectorRenderer::RectParams>(rects, rects + count), handles);
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::AddLines(const VectorRenderer::LineParams* lines, size_t count, ShapeHandle* handles)
+{
+	AddLines(std::vector<VectorRenderer::LineParams>(lines, lines + count), handles);
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::AddBezierCurves(const VectorRenderer::BezierCurveParams* curves, size_t count, ShapeHandle* handles)
+{
+	AddBezierCurves(std::vector<VectorRenderer::BezierCurveParams>(curves, curves + count), handles);
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::AddCubicBezierCurves(const VectorRenderer::CubicBezierCurveParams* curves, size_t count, ShapeHandle* handles)
+{
+	AddCubicBezierCurves(std::vector<VectorRenderer::CubicBezierCurveParams>(curves, curves + count), handles);
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::AddRects(std::vector<VectorRenderer::RectParams>&& rects, ShapeHandle* handles)
+{
+	PostBulk(std::move(rects), handles, &VectorRenderer::InsertRects);
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::AddLines(std::vector<VectorRenderer::LineParams>&& lines, ShapeHandle* handles)
+{
+	PostBulk(std::move(lines), handles, &VectorRenderer::InsertLines);
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::AddBezierCurves(std::vector<VectorRenderer::BezierCurveParams>&& curves, ShapeHandle* handles)
+{
+	PostBulk(std::move(curves), handles, &VectorRenderer::InsertBezierCurves);
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::AddCubicBezierCurves(std::vector<VectorRenderer::CubicBezierCurveParams>&& curves, ShapeHandle* handles)
+{
+	PostBulk(std::move(curves), handles, &VectorRenderer::InsertCubicBezierCurves);
+}
+
+//------------------------------------------------------------------------------
+template <typename Params, typename Insert>
+void RenderThread::PostBulk(std::vector<Params>&& params, ShapeHandle* handles, Insert insert)
+{
+	std::vector<ShapeHandle> assigned(params.size());
+	for (size_t i = 0; i < assigned.size(); ++i)
+	{
+		assigned[i] = mHandles.Allocate();
+		if (handles != nullptr)
+		{
+			handles[i] = assigned[i];
+		}
+	}
+
+	// Moved into the command rather than copied again
+	Post([params = std::move(params), assigned = std::move(assigned), insert](VectorRenderer& renderer)
+	{
+		(renderer.*insert)(params.data(), params.size(), assigned.data());
+	});
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::UpdateShape(ShapeHandle handle, const IVectorShape* shape)
+{
+	Post(MakeUpdateShape(handle, shape));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::RemoveShape(ShapeHandle handle)
+{
+	Post(MakeRemoveShape(handle));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::RestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill)
+{
+	Post(MakeRestyleShape(handle, stroke, fill));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::ClearShapes()
+{
+	// Released on the render thread rather than here, so only what is already in the renderer goes. Handles
+	// another thread has been given for shapes still on their way stay live, and those whose removal is queued
+	// are recycled by it.
+	ShapeHandleAllocator* handles = &mHandles;
+	GroupHandleAllocator* groupHandles = &mGroupHandles;
+	Post([handles, groupHandles](VectorRenderer& renderer)
+	{
+		const std::vector<uint32_t> released = handles->Release(renderer.GetShapeHandles());
+		const std::vector<uint32_t> releasedGroups = groupHandles->Release(renderer.GetGroupHandles());
+		renderer.ClearShapes();
+		handles->Recycle(released.data(), released.size());
+		groupHandles->Recycle(releasedGroups.data(), releasedGroups.size());
+	});
+}
+
+//------------------------------------------------------------------------------
+GroupHandle RenderThread::AddGroup(GroupHandle parent)
+{
+	const GroupHandle handle = mGroupHandles.Allocate();
+	Post([handle, parent](VectorRenderer& renderer)
+	{
+		renderer.InsertGroup(handle, parent);
+	});
+	return handle;
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::SetGroupTransform(GroupHandle group, const Transform& transform)
+{
+	Post(MakeSetGroupTransform(group, transform));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::RemoveGroup(GroupHandle group)
+{
+	if (!mGroupHandles.Release(group))
+	{
+		ASSERT(false, "Removing a stale group");
+		return;
+	}
+
+	// A clear queued ahead of the removal may have taken the group already, the index is still recycled here
+	GroupHandleAllocator* groupHandles = &mGroupHandles;
+	Post([group, groupHandles](VectorRenderer& renderer)
+	{
+		if (renderer.HasGroup(group))
+		{
+			renderer.RemoveGroup(group);
+		}
+		groupHandles->Recycle(&group.index, 1);
+	});
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::SetShapeGroup(ShapeHandle shape, GroupHandle group)
+{
+	Post(MakeSetShapeGroup(shape, group));
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Submit(Batch& batch)
+{
+	// One queue entry, so the render thread applies all of it in the same frame
+	std::vector<Command> commands;
+	commands.swap(batch.mCommands);
+	if (commands.empty())
+	{
+		return;
+	}
+
+	Post([commands = std::move(commands)](VectorRenderer& renderer)
+	{
+		for (const Command& command : commands)
+		{
+			command(renderer);
+		}
+	});
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::PresentScene(const SceneSnapshot& scene)
+{
+	Post([scene](VectorRenderer& renderer)
+	{
+		renderer.SetScene(scene);
+	});
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Command RenderThread::MakeAddShape(const IVectorShape* shape, ShapeHandle& handle)
+{
+	handle = mHandles.Allocate();
+	const ShapeHandle assigned = handle;
+	return [assigned, shape](VectorRenderer& renderer)
+	{
+		renderer.InsertShape(assigned, shape);
+	};
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Command RenderThread::MakeUpdateShape(ShapeHandle handle, const IVectorShape* shape)
+{
+	// The handle can still go stale before the command runs, the renderer checks again
+	if (!mHandles.IsLive(handle))
+	{
+		ASSERT(false, "Updating a shape through a stale handle");
+		delete shape;
+		return Command();
+	}
+
+	return [handle, shape](VectorRenderer& renderer)
+	{
+		renderer.UpdateShape(handle, shape);
+	};
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Command RenderThread::MakeRemoveShape(ShapeHandle handle)
+{
+	if (!mHandles.Release(handle))
+	{
+		ASSERT(false, "Removing a shape through a stale handle");
+		return Command();
+	}
+
+	// The index is reused only after the removal, whichever thread queues the next shape for it. A clear queued
+	// ahead of the removal may have taken the shape already.
+	ShapeHandleAllocator* handles = &mHandles;
+	return [handle, handles](VectorRenderer& renderer)
+	{
+		if (renderer.GetShape(handle) != nullptr)
+		{
+			renderer.RemoveShape(handle);
+		}
+		handles->Recycle(&handle.index, 1);
+	};
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Command RenderThread::MakeRestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill)
+{
+	return [handle, stroke, fill](VectorRenderer& renderer)
+	{
+		renderer.RestyleShape(handle, stroke, fill);
+	};
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Command RenderThread::MakeSetGroupTransform(GroupHandle group, const Transform& transform)
+{
+	return [group, transform](VectorRenderer& renderer)
+	{
+		renderer.SetGroupTransform(group, transform);
+	};
+}
+
+//------------------------------------------------------------------------------
+RenderThread::Command RenderThread::MakeSetShapeGroup(ShapeHandle shape, GroupHandle group)
+{
+	return [shape, group](VectorRenderer& renderer)
+	{
+		renderer.SetShapeGroup(shape, group);
+	};
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::SetCamera(const Camera& camera)
+{
+	Post([camera](VectorRenderer& renderer)
+	{
+		renderer.GetCamera() = camera;
+	});
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Resize(int32_t width, int32_t height)
+{
+	IRenderDevice* renderDevice = mRenderDevice;
+	Post([renderDevice, width, height](VectorRenderer& /*renderer*/)
+	{
+		renderDevice->Resize(width, height);
+	});
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::RequestFrame()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mFrameRequested = true;
+	}
+	mWake.notify_one();
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::SetContinuousRendering(double framesPerSecond)
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mContinuousFramesPerSecond = std::max(framesPerSecond, 0.0);
+	}
+	mWake.notify_one();
+}
+
+//------------------------------------------------------------------------------
+FrameStats RenderThread::GetFrameStats() const
+{
+	FrameStats stats;
+	stats.frameCount = mFrameCount.load(std::memory_order_relaxed);
+	stats.frameMilliseconds = mFrameMicroseconds.load(std::memory_order_relaxed) / 1000.0;
+	return stats;
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Post(Command command)
+{
+	if (command)
+	{
+		mCommands.Push(std::move(command));
+		RequestFrame();
+	}
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::Run(void* windowHandle, int32_t width, int32_t height)
+{
+	const bool initialized = mRenderDevice->Initialize(windowHandle, width, height);
+	ASSERT(initialized, "Failed to initialize render device");
+
+	const bool shadersLoaded = mRenderDevice->LoadShaders();
+	ASSERT(shadersLoaded, "Failed to load shaders");
+
+	VectorRenderer* renderer = new VectorRenderer(mRenderDevice);
+	std::chrono::steady_clock::time_point lastFrame;
+	while (WaitForFrame(lastFrame))
+	{
+		const auto start = std::chrono::steady_clock::now();
+		lastFrame = start;
+		ExecuteCommands(*renderer);
+		renderer->Render();
+		const auto end = std::chrono::steady_clock::now();
+
+		mFrameMicroseconds.store(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), std::memory_order_relaxed);
+		mFrameCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Shapes still in the queue are owned by the scene too
+	ExecuteCommands(*renderer);
+	delete renderer;
+
+	mRenderDevice->Shutdown();
+	delete mRenderDevice;
+	mRenderDevice = nullptr;
+}
+
+//------------------------------------------------------------------------------
+bool RenderThread::WaitForFrame(std::chrono::steady_clock::time_point lastFrame)
+{
+	// Sleeps until a frame is requested, or in continuous mode until the next one is due. Returns false when
+	// the thread is stopping.
+	std::unique_lock<std::mutex> lock(mWakeMutex);
+	while (!mStopping)
+	{
+		if (mContinuousFramesPerSecond > 0.0)
+		{
+			const auto interval = std::chrono::duration<double>(1.0 / mContinuousFramesPerSecond);
+			const auto next = lastFrame + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+			if (std::chrono::steady_clock::now() >= next)
+			{
+				mFrameRequested = false;
+				return true;
+			}
+			mWake.wait_until(lock, next);
+		}
+		else if (mFrameRequested)
+		{
+			mFrameRequested = false;
+			return true;
+		}
+		else
+		{
+			mWake.wait(lock);
+		}
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------
+void RenderThread::ExecuteCommands(VectorRenderer& renderer)
+{
+	Command command;
+	while (mCommands.TryPop(command))
+	{
+		if (command)
+		{
+			command(renderer);
+		}
+	}
+}
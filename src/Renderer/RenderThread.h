@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Camera.h"
+#include "ShapeHandle.h"
+#include "VectorRenderer.h"
+
+// Utils
+#include <Utils/MpscQueue.h>
+
+// System
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+class IRenderDevice;
+
+// Read back from the render thread. The fields are updated separately, so they may be a frame apart.
+//------------------------------------------------------------------------------
+struct FrameStats
+{
+	uint64_t frameCount = 0;
+
+	// Wall time of the last frame, including the wait for vsync
+	double frameMilliseconds = 0.0;
+};
+
+// Thread that owns the render device and the scene, so long frames don't stall the threads submitting to it.
+// Everything is posted through a lock-free queue and applied in order at the start of the render thread's next
+// frame. Frames are only rendered when something was posted or requested, so an idle scene costs nothing.
+// Any number of threads may post, none of them ever waits for a frame.
+//------------------------------------------------------------------------------
+class RenderThread
+{
+	typedef std::function<void(VectorRenderer&)> Command;
+
+public:
+	// Scene mutations recorded on one thread and applied together, so the frame never shows only part of them.
+	// Handles are valid as soon as the functions return. A batch still holding mutations when it is destroyed
+	// submits them, so the handles it gave out always end up referring to shapes in the scene.
+	class Batch
+	{
+	public:
+		Batch(Batch&& other);
+		~Batch();
+
+		Batch(const Batch&) = delete;
+		Batch& operator=(const Batch&) = delete;
+
+		ShapeHandle AddShape(const IVectorShape* shape);
+		void UpdateShape(ShapeHandle handle, const IVectorShape* shape);
+		void RemoveShape(ShapeHandle handle);
+		void RestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill);
+		void SetGroupTransform(GroupHandle group, const Transform& transform);
+		void SetShapeGroup(ShapeHandle shape, GroupHandle group);
+
+	private:
+		friend class RenderThread;
+		Batch(RenderThread& owner) : mOwner(owner) {}
+
+		// Commands for stale handles come back empty and are left out
+		void Push(Command command);
+
+		RenderThread& mOwner;
+		std::vector<Command> mCommands;
+	};
+
+	// Takes ownership of the device, which is initialized and used on the render thread only
+	RenderThread(IRenderDevice* renderDevice, void* windowHandle, int32_t width, int32_t height);
+	~RenderThread();
+
+	// Same as the VectorRenderer functions, each applied on its own. Shapes are owned by the scene once posted
+	// and must not be changed afterwards, handles are valid right away.
+	ShapeHandle AddShape(const IVectorShape* shape);
+	void AddRects(const VectorRenderer::RectParams* rects, size_t count, ShapeHandle* handles = nullptr);
+	void AddLines(const VectorRenderer::LineParams* lines, size_t count, ShapeHandle* handles = nullptr);
+	void AddBezierCurves(const VectorRenderer::BezierCurveParams* curves, size_t count, ShapeHandle* handles = nullptr);
+	void AddCubicBezierCurves(const VectorRenderer::CubicBezierCurveParams* curves, size_t count, ShapeHandle* handles = nullptr);
+
+	// The bulk functions copy the parameters for the render thread, these take over arrays the caller is done with
+	void AddRects(std::vector<VectorRenderer::RectParams>&& rects, ShapeHandle* handles = nullptr);
+	void AddLines(std::vector<VectorRenderer::LineParams>&& lines, ShapeHandle* handles = nullptr);
+	void AddBezierCurves(std::vector<VectorRenderer::BezierCurveParams>&& curves, ShapeHandle* handles = nullptr);
+	void AddCubicBezierCurves(std::vector<VectorRenderer::CubicBezierCurveParams>&& curves, ShapeHandle* handles = nullptr);
+
+	void UpdateShape(ShapeHandle handle, const IVectorShape* shape);
+	void RemoveShape(ShapeHandle handle);
+	void RestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill);
+
+	// Clears what has reached the render thread when the clear does. Shapes other threads are still adding
+	// aren't affected.
+	void ClearShapes();
+
+	GroupHandle AddGroup(GroupHandle parent = GroupHandle());
+	void SetGroupTransform(GroupHandle group, const Transform& transform);
+	void RemoveGroup(GroupHandle group);
+	void SetShapeGroup(ShapeHandle shape, GroupHandle group);
+
+	Batch BeginBatch() { return Batch(*this); }
+	void Submit(Batch& batch);
+
+	// Shows a version of a Scene edited on another thread, instead of the shapes posted through the functions
+	// above. Only a reference is posted, the render thread applies what changed since the last version it showed.
+	void PresentScene(const SceneSnapshot& scene);
+
+	void SetCamera(const Camera& camera);
+	void Resize(int32_t width, int32_t height);
+
+	// Renders once with whatever has been posted, requests made during a frame are merged into one. Posting
+	// anything requests a frame, this is for when the window contents were lost.
+	void RequestFrame();
+
+	// Renders continuously at up to the given rate, for animations. Zero goes back to rendering on demand.
+	void SetContinuousRendering(double framesPerSecond);
+
+	FrameStats GetFrameStats() const;
+
+private:
+	// Handle bookkeeping is done when a command is made, on the posting thread
+	Command MakeAddShape(const IVectorShape* shape, ShapeHandle& handle);
+	Command MakeUpdateShape(ShapeHandle handle, const IVectorShape* shape);
+	Command MakeRemoveShape(ShapeHandle handle);
+	Command MakeRestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill);
+	Command MakeSetGroupTransform(GroupHandle group, const Transform& transform);
+	Command MakeSetShapeGroup(ShapeHandle shape, GroupHandle group);
+
+	template <typename Params, typename Insert>
+	void PostBulk(std::vector<Params>&& params, ShapeHandle* handles, Insert insert);
+
+	void Post(Command command);
+	void Run(void* windowHandle, int32_t width, int32_t height);
+	bool WaitForFrame(std::chrono::steady_clock::time_point lastFrame);
+	void ExecuteCommands(VectorRenderer& renderer);
+
+	IRenderDevice* mRenderDevice = nullptr;
+
+	ShapeHandleAllocator mHandles;
+	GroupHandleAllocator mGroupHandles;
+	MpscQueue<Command> mCommands;
+
+	// Wakes the render thread, which otherwise sleeps between frames. Never held while rendering.
+	std::mutex mWakeMutex;
+	std::condition_variable mWake;
+	bool mFrameRequested = true;
+	bool mStopping = false;
+	double mContinuousFramesPerSecond = 0.0;
+
+	std::atomic<uint64_t> mFrameCount { 0 };
+	std::atomic<uint64_t> mFrameMicroseconds { 0 };
+
+	std::thread mThread;
+};
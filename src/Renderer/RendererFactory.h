@@ -2,6 +2,7 @@
 
 #include "IRenderDevice.h"
 #include "DirectXRenderDevice.h"
+#include "SoftwareRenderDevice.h"
 
 // Utils
 #include <Utils/Assert.h>
@@ -18,6 +19,10 @@ public:
 		{
 			return new DirectXRenderDevice();
 		}
+		case GraphicsBackend::Software:
+		{
+			return new SoftwareRenderDevice();
+		}
 		default:
 		{
 			ASSERT(false, "Unsupported graphics backend");
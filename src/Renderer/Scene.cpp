@@ -0,0 +1,244 @@
+#include "Scene.h"
+
+// Utils
+#include <Utils/Assert.h>
+
+// Vector
+#include <Vector/VectorShape.h>
+
+// System
+#include <algorithm>
+#include <atomic>
+
+//------------------------------------------------------------------------------
+const IVectorShape* SceneSnapshot::GetShape(ShapeHandle handle) const
+{
+	const Entry* entry = FindEntry(handle.index);
+	if (entry == nullptr || entry->generation != handle.generation)
+	{
+		return nullptr;
+	}
+	return entry->shape.get();
+}
+
+//------------------------------------------------------------------------------
+const SceneSnapshot::Entry* SceneSnapshot::FindEntry(uint32_t index) const
+{
+	const Node* node = mRoot.get();
+	if (node == nullptr || (static_cast<uint64_t>(index) >> mRootShift) >= kNodeSize)
+	{
+		return nullptr;
+	}
+
+	for (uint32_t shift = mRootShift; shift > 0; shift -= kNodeBits)
+	{
+		node = static_cast<const Branch*>(node)->children[(index >> shift) & kNodeMask].get();
+		if (node == nullptr)
+		{
+			return nullptr;
+		}
+	}
+	return &static_cast<const Leaf*>(node)->entries[index & kNodeMask];
+}
+
+//------------------------------------------------------------------------------
+/*static*/ void SceneSnapshot::Diff(const SceneSnapshot& from, const SceneSnapshot& to, std::vector<Change>& changes)
+{
+	const DiffSide fromRoot = { from.mRoot.get(), from.mRootShift };
+	const DiffSide toRoot = { to.mRoot.get(), to.mRootShift };
+	DiffNodes(fromRoot, toRoot, std::max(from.mRootShift, to.mRootShift), 0, changes);
+}
+
+//------------------------------------------------------------------------------
+/*static*/ SceneSnapshot::DiffSide SceneSnapshot::GetChild(const DiffSide& side, uint32_t shift, uint32_t child)
+{
+	const DiffSide none = { nullptr, 0 };
+	if (side.node == nullptr)
+	{
+		return none;
+	}
+	if (side.shift < shift)
+	{
+		return child == 0 ? side : none;
+	}
+
+	const DiffSide result = { static_cast<const Branch*>(side.node)->children[child].get(), shift - kNodeBits };
+	return result;
+}
+
+//------------------------------------------------------------------------------
+/*static*/ void SceneSnapshot::DiffNodes(const DiffSide& from, const DiffSide& to, uint32_t shift, uint64_t base, std::vector<Change>& changes)
+{
+	// Shared by both versions, or missing from both
+	if (from.node == to.node && (from.node == nullptr || from.shift == to.shift))
+	{
+		return;
+	}
+
+	if (shift > 0)
+	{
+		for (uint32_t i = 0; i < kNodeSize; ++i)
+		{
+			DiffNodes(GetChild(from, shift, i), GetChild(to, shift, i), shift - kNodeBits, base + (static_cast<uint64_t>(i) << shift), changes);
+		}
+		return;
+	}
+
+	const Leaf* fromLeaf = static_cast<const Leaf*>(from.node);
+	const Leaf* toLeaf = static_cast<const Leaf*>(to.node);
+	for (uint32_t i = 0; i < kNodeSize; ++i)
+	{
+		const Entry* fromEntry = fromLeaf != nullptr && fromLeaf->entries[i].shape != nullptr ? &fromLeaf->entries[i] : nullptr;
+		const Entry* toEntry = toLeaf != nullptr && toLeaf->entries[i].shape != nullptr ? &toLeaf->entries[i] : nullptr;
+		if (fromEntry == nullptr && toEntry == nullptr)
+		{
+			continue;
+		}
+		if (fromEntry != nullptr && toEntry != nullptr && fromEntry->shape == toEntry->shape && fromEntry->generation == toEntry->generation)
+		{
+			continue;
+		}
+
+		Change change;
+		change.index = static_cast<uint32_t>(base + i);
+		change.from = fromEntry;
+		change.to = toEntry;
+		changes.push_back(change);
+	}
+}
+
+//------------------------------------------------------------------------------
+ShapeHandle Scene::AddShape(const IVectorShape* shape)
+{
+	// Computed now, while only this thread can see the shape, so the cache is never written once it is shared
+	shape->GetBounds();
+
+	ShapeHandle handle;
+	const bool reused = !mFreeIndices.empty();
+	if (reused)
+	{
+		handle.index = mFreeIndices.back();
+		mFreeIndices.pop_back();
+	}
+	else
+	{
+		handle.index = mIndexCount++;
+	}
+
+	SceneSnapshot::Entry& entry = GetMutableEntry(handle.index);
+	if (!reused)
+	{
+		entry.generation = mFirstGeneration;
+	}
+	entry.shape.reset(shape);
+	entry.order = mNextOrder++;
+	++mCurrent.mShapeCount;
+
+	handle.generation = entry.generation;
+	mLastGeneration = std::max(mLastGeneration, entry.generation);
+	return handle;
+}
+
+//------------------------------------------------------------------------------
+void Scene::UpdateShape(ShapeHandle handle, const IVectorShape* shape)
+{
+	if (GetShape(handle) == nullptr)
+	{
+		ASSERT(false, "Updating a shape through a stale handle");
+		delete shape;
+		return;
+	}
+
+	shape->GetBounds();
+	GetMutableEntry(handle.index).shape.reset(shape);
+}
+
+//------------------------------------------------------------------------------
+void Scene::RemoveShape(ShapeHandle handle)
+{
+	if (GetShape(handle) == nullptr)
+	{
+		ASSERT(false, "Removing a shape through a stale handle");
+		return;
+	}
+
+	// The shape itself goes with the last snapshot that still has it
+	SceneSnapshot::Entry& entry = GetMutableEntry(handle.index);
+	entry.shape.reset();
+	++entry.generation;
+	--mCurrent.mShapeCount;
+	mFreeIndices.push_back(handle.index);
+}
+
+//------------------------------------------------------------------------------
+void Scene::ClearShapes()
+{
+	// Draw order keeps counting up, so a renderer showing the old version can tell the new shapes go last
+	mCurrent = SceneSnapshot();
+	mFreeIndices.clear();
+	mIndexCount = 0;
+	mFirstGeneration = mLastGeneration + 1;
+	mLastGeneration = mFirstGeneration;
+}
+
+//------------------------------------------------------------------------------
+SceneSnapshot::Entry& Scene::GetMutableEntry(uint32_t index)
+{
+	typedef SceneSnapshot::Node Node;
+	typedef SceneSnapshot::Branch Branch;
+	typedef SceneSnapshot::Leaf Leaf;
+
+	// Add levels on top until the index fits, the old root becomes the first child
+	std::shared_ptr<Node>& root = mCurrent.mRoot;
+	if (root == nullptr)
+	{
+		root = std::make_shared<Leaf>();
+		mCurrent.mRootShift = 0;
+	}
+	while ((static_cast<uint64_t>(index) >> mCurrent.mRootShift) >= SceneSnapshot::kNodeSize)
+	{
+		std::shared_ptr<Branch> branch = std::make_shared<Branch>();
+		branch->children[0] = std::move(root);
+		root = std::move(branch);
+		mCurrent.mRootShift += SceneSnapshot::kNodeBits;
+	}
+
+	std::shared_ptr<Node>* node = &root;
+	for (uint32_t shift = mCurrent.mRootShift; shift > 0; shift -= SceneSnapshot::kNodeBits)
+	{
+		MakeUnique(*node, shift);
+		node = &static_cast<Branch&>(**node).children[(index >> shift) & SceneSnapshot::kNodeMask];
+	}
+	MakeUnique(*node, 0);
+	return static_cast<Leaf&>(**node).entries[index & SceneSnapshot::kNodeMask];
+}
+
+//------------------------------------------------------------------------------
+/*static*/ void Scene::MakeUnique(std::shared_ptr<SceneSnapshot::Node>& node, uint32_t shift)
+{
+	typedef SceneSnapshot::Branch Branch;
+	typedef SceneSnapshot::Leaf Leaf;
+
+	if (node == nullptr)
+	{
+		node = shift > 0 ? std::shared_ptr<SceneSnapshot::Node>(std::make_shared<Branch>()) : std::make_shared<Leaf>();
+		return;
+	}
+
+	// Nothing else can reach a node only this scene refers to. The fence pairs with the release of the last
+	// snapshot that shared it, which may have happened on another thread.
+	if (node.use_count() == 1)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return;
+	}
+
+	if (shift > 0)
+	{
+		node = std::make_shared<Branch>(static_cast<const Branch&>(*node));
+	}
+	else
+	{
+		node = std::make_shared<Leaf>(static_cast<const Leaf&>(*node));
+	}
+}
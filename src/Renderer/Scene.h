@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ShapeHandle.h"
+
+// System
+#include <memory>
+#include <vector>
+
+//------------------------------------------------------------------------------
+class IVectorShape;
+
+// Immutable version of a Scene. Copying one is O(1), versions share every part of the scene that didn't change
+// between them, so a renderer can keep drawing one version while the next is being edited.
+//------------------------------------------------------------------------------
+class SceneSnapshot
+{
+public:
+	// A shape and where it goes in the draw order. Entries never change once they are in a snapshot.
+	struct Entry
+	{
+		std::shared_ptr<const IVectorShape> shape; // Null for an unused index
+		uint64_t order = 0;
+		uint32_t generation = 0;
+	};
+
+	// Index whose entry differs between two versions, null on the side where it is unused
+	struct Change
+	{
+		uint32_t index;
+		const Entry* from;
+		const Entry* to;
+	};
+
+	size_t GetShapeCount() const { return mShapeCount; }
+
+	// Null if the handle is stale
+	const IVectorShape* GetShape(ShapeHandle handle) const;
+	const Entry* FindEntry(uint32_t index) const;
+
+	// Appends every index that differs between the versions. Subtrees the versions share are skipped, so the cost
+	// follows the number of changes rather than the size of the scene. The entries belong to the snapshots.
+	static void Diff(const SceneSnapshot& from, const SceneSnapshot& to, std::vector<Change>& changes);
+
+private:
+	friend class Scene;
+
+	// Trie from handle index to entry, kNodeBits of the index per level. Leaves are at shift 0.
+	static const uint32_t kNodeBits = 5;
+	static const uint32_t kNodeSize = 1u << kNodeBits;
+	static const uint32_t kNodeMask = kNodeSize - 1;
+
+	struct Node
+	{
+	};
+
+	struct Branch : Node
+	{
+		std::shared_ptr<Node> children[kNodeSize];
+	};
+
+	struct Leaf : Node
+	{
+		Entry entries[kNodeSize];
+	};
+
+	// Subtree on one side of a diff. A tree shallower than the level being walked is the first child of each
+	// level it is missing.
+	struct DiffSide
+	{
+		const Node* node;
+		uint32_t shift;
+	};
+
+	static DiffSide GetChild(const DiffSide& side, uint32_t shift, uint32_t child);
+	static void DiffNodes(const DiffSide& from, const DiffSide& to, uint32_t shift, uint64_t base, std::vector<Change>& changes);
+
+	std::shared_ptr<Node> mRoot;
+	uint32_t mRootShift = 0;
+	size_t mShapeCount = 0;
+};
+
+// Editable scene with persistent versions. Edits copy only the path from the root to the changed entry, and only
+// when a snapshot still shares it, so a run of edits between two snapshots copies each path once.
+// Use from one thread, snapshots can be handed to any other.
+//------------------------------------------------------------------------------
+class Scene
+{
+public:
+	// The scene owns the shapes, which must not change once added. Shapes draw in the order they were added, an
+	// updated shape keeps its place.
+	ShapeHandle AddShape(const IVectorShape* shape);
+	void UpdateShape(ShapeHandle handle, const IVectorShape* shape);
+	void RemoveShape(ShapeHandle handle);
+	void ClearShapes();
+
+	// Null if the handle is stale
+	const IVectorShape* GetShape(ShapeHandle handle) const { return mCurrent.GetShape(handle); }
+	size_t GetShapeCount() const { return mCurrent.GetShapeCount(); }
+
+	SceneSnapshot GetSnapshot() const { return mCurrent; }
+
+private:
+	SceneSnapshot::Entry& GetMutableEntry(uint32_t index);
+	static void MakeUnique(std::shared_ptr<SceneSnapshot::Node>& node, uint32_t shift);
+
+	SceneSnapshot mCurrent;
+	std::vector<uint32_t> mFreeIndices;
+	uint32_t mIndexCount = 0;
+	uint64_t mNextOrder = 0;
+
+	// Indices unused since the last clear start above every generation handed out, so old handles stay stale
+	uint32_t mFirstGeneration = 0;
+	uint32_t mLastGeneration = 0;
+};
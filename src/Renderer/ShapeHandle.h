@@ -0,0 +1,123 @@
+#pragma once
+
+// System
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+// Reference to a shape owned by a VectorRenderer. The generation changes whenever the slot is freed, so a handle
+// to a removed shape is detected instead of silently referring to whatever reuses its slot.
+//------------------------------------------------------------------------------
+struct ShapeHandle
+{
+	bool IsValid() const { return index != UINT32_MAX; }
+
+	bool operator==(const ShapeHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const ShapeHandle& other) const { return !(*this == other); }
+
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+};
+
+// Reference to a group of shapes owned by a VectorRenderer, stale in the same way as a ShapeHandle. The invalid
+// handle stands for the root group, which is world space itself.
+//------------------------------------------------------------------------------
+struct GroupHandle
+{
+	bool IsValid() const { return index != UINT32_MAX; }
+
+	bool operator==(const GroupHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const GroupHandle& other) const { return !(*this == other); }
+
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+};
+
+// Hands out handles ahead of the renderer that stores the shapes or groups, for producers that can't wait for it (such as
+// threads posting to the render thread). Safe to use from any thread. A released index is only handed out again
+// once it is recycled, which the owner of the renderer does after the removal has been applied, so a new shape
+// can never be queued into a slot ahead of the removal of the old one.
+//------------------------------------------------------------------------------
+template <typename Handle>
+class HandleAllocator
+{
+public:
+	Handle Allocate()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		Handle handle;
+		if (!mFreeIndices.empty())
+		{
+			handle.index = mFreeIndices.back();
+			mFreeIndices.pop_back();
+		}
+		else
+		{
+			handle.index = static_cast<uint32_t>(mGenerations.size());
+			mGenerations.push_back(0);
+			mLive.push_back(false);
+		}
+		handle.generation = mGenerations[handle.index];
+		mLive[handle.index] = true;
+		return handle;
+	}
+
+	// Makes the handle stale, returns false if it already was
+	bool Release(Handle handle)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!IsLiveLocked(handle))
+		{
+			return false;
+		}
+		++mGenerations[handle.index];
+		mLive[handle.index] = false;
+		return true;
+	}
+
+	// Releases those of the handles that are still live, under one lock for all of them, and returns their indices
+	std::vector<uint32_t> Release(const std::vector<Handle>& handles)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::vector<uint32_t> released;
+		released.reserve(handles.size());
+		for (const Handle& handle : handles)
+		{
+			if (IsLiveLocked(handle))
+			{
+				++mGenerations[handle.index];
+				mLive[handle.index] = false;
+				released.push_back(handle.index);
+			}
+		}
+		return released;
+	}
+
+	// Lets released indices be handed out again
+	void Recycle(const uint32_t* indices, size_t count)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFreeIndices.insert(mFreeIndices.end(), indices, indices + count);
+	}
+
+	bool IsLive(Handle handle) const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return IsLiveLocked(handle);
+	}
+
+private:
+	bool IsLiveLocked(Handle handle) const
+	{
+		return handle.index < mGenerations.size() && mLive[handle.index] && mGenerations[handle.index] == handle.generation;
+	}
+
+	// Only held for the bookkeeping itself, never while rendering
+	mutable std::mutex mMutex;
+	std::vector<uint32_t> mGenerations;
+	std::vector<bool> mLive;
+	std::vector<uint32_t> mFreeIndices;
+};
+
+typedef HandleAllocator<ShapeHandle> ShapeHandleAllocator;
+typedef HandleAllocator<GroupHandle> GroupHandleAllocator;
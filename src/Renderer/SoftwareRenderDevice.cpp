@@ -0,0 +1,1242 @@
+#include "SoftwareRenderDevice.h"
+
+// Utils
+#include <Utils/Assert.h>
+#include <Utils/Bounds.h>
+
+// External
+#include <emmintrin.h>
+
+// System
+#include <algorithm>
+#include <cmath>
+
+// Side of the square tiles occlusion is tracked in, fully covered tiles are skipped whole
+static const int32_t kTileShift = 3;
+static const int32_t kTileSize = 1 << kTileShift;
+
+//------------------------------------------------------------------------------
+static uint8_t ToChannel(float value)
+{
+	return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+//------------------------------------------------------------------------------
+static uint32_t ToColor(float r, float g, float b, float a)
+{
+	return (static_cast<uint32_t>(ToChannel(a)) << 24)
+		| (static_cast<uint32_t>(ToChannel(r)) << 16)
+		| (static_cast<uint32_t>(ToChannel(g)) << 8)
+		| static_cast<uint32_t>(ToChannel(b));
+}
+
+// Alpha in 0-256 so that a full blend is a shift instead of a divide
+//------------------------------------------------------------------------------
+static uint16_t ToBlendFactor(float a)
+{
+	return static_cast<uint16_t>(std::min(std::max(a, 0.0f), 1.0f) * 256.0f + 0.5f);
+}
+
+//------------------------------------------------------------------------------
+static float EdgeFunction(float ax, float ay, float bx, float by, float px, float py)
+{
+	return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+// Clamped while still a float, a coordinate far outside the framebuffer doesn't fit in an int32_t. NaN goes to
+// the low end.
+//------------------------------------------------------------------------------
+static int32_t ClampToPixel(float value, int32_t low, int32_t high)
+{
+	if (!(value > static_cast<float>(low)))
+	{
+		return low;
+	}
+	if (!(value < static_cast<float>(high)))
+	{
+		return high;
+	}
+	return static_cast<int32_t>(value);
+}
+
+// Liang-Barsky, shortens the segment to the part inside the box and returns false if none of it is. A segment
+// already inside is left exactly as it was.
+//------------------------------------------------------------------------------
+static bool ClipSegment(const Bounds& box, double& x1, double& y1, double& x2, double& y2)
+{
+	const double dx = x2 - x1;
+	const double dy = y2 - y1;
+	const double p[4] = { -dx, dx, -dy, dy };
+	const double q[4] = { x1 - box.minX, box.maxX - x1, y1 - box.minY, box.maxY - y1 };
+
+	double enter = 0.0;
+	double leave = 1.0;
+	for (int32_t i = 0; i < 4; ++i)
+	{
+		if (p[i] == 0.0)
+		{
+			// Parallel to this side, and entirely outside it or not at all
+			if (q[i] < 0.0)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const double t = q[i] / p[i];
+		if (p[i] < 0.0)
+		{
+			enter = std::max(enter, t);
+		}
+		else
+		{
+			leave = std::min(leave, t);
+		}
+	}
+	if (enter > leave)
+	{
+		return false;
+	}
+
+	const double startX = x1;
+	const double startY = y1;
+	if (enter > 0.0)
+	{
+		x1 = startX + dx * enter;
+		y1 = startY + dy * enter;
+	}
+	if (leave < 1.0)
+	{
+		x2 = startX + dx * leave;
+		y2 = startY + dy * leave;
+	}
+	return true;
+}
+
+// Pixels exactly on an edge belong to only one of the two triangles sharing it, so translucent meshes
+// don't double blend along their internal edges
+//------------------------------------------------------------------------------
+static bool OwnsEdge(float ax, float ay, float bx, float by)
+{
+	return (by > ay) || (by == ay && bx < ax);
+}
+
+// A covered tile or row has no pixels left for opaque geometry, and hides translucent geometry behind all of it
+//------------------------------------------------------------------------------
+static bool IsCoveredFor(uint32_t uncovered, uint32_t coverOrder, uint32_t order, bool opaquePass)
+{
+	return uncovered == 0 && (opaquePass || order < coverOrder);
+}
+
+//------------------------------------------------------------------------------
+SoftwareRenderDevice::SoftwareRenderDevice()
+{
+}
+
+//------------------------------------------------------------------------------
+SoftwareRenderDevice::~SoftwareRenderDevice()
+{
+	Shutdown();
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool SoftwareRenderDevice::Initialize(void* windowHandle, int32_t width, int32_t height)
+{
+	mHWND = static_cast<HWND>(windowHandle);
+	Resize(width, height);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::Resize(int32_t width, int32_t height)
+{
+	mWidth = std::max(width, 0);
+	mHeight = std::max(height, 0);
+	mFramebuffer.assign(static_cast<size_t>(mWidth) * mHeight, 0xFF000000u);
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::PreRender()
+{
+	FillSpan(mFramebuffer.data(), static_cast<int32_t>(mFramebuffer.size()), 0xFF000000u);
+	ClearFrame();
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::Render()
+{
+	ResolveFrame();
+
+	if (mHWND == 0 || mFramebuffer.empty())
+	{
+		return;
+	}
+
+	BITMAPINFO bitmapInfo = {};
+	bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bitmapInfo.bmiHeader.biWidth = mWidth;
+	bitmapInfo.bmiHeader.biHeight = -mHeight; // Negative for top-down rows
+	bitmapInfo.bmiHeader.biPlanes = 1;
+	bitmapInfo.bmiHeader.biBitCount = 32;
+	bitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+	HDC deviceContext = GetDC(mHWND);
+	SetDIBitsToDevice(deviceContext, 0, 0, mWidth, mHeight, 0, 0, 0, mHeight, mFramebuffer.data(), &bitmapInfo, DIB_RGB_COLORS);
+	ReleaseDC(mHWND, deviceContext);
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::Shutdown()
+{
+	mFramebuffer.clear();
+	mVertexBuffer.clear();
+	mIndexBuffer.clear();
+	ClearFrame();
+	mHWND = 0;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool SoftwareRenderDevice::LoadShaders()
+{
+	// Shading is fixed function on the CPU
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::CreateVertexBuffer(const Vertex* vertices, size_t size)
+{
+	mVertexBuffer.assign(vertices, vertices + size / sizeof(Vertex));
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::CreateIndexBuffer(const uint16_t* indices, size_t size)
+{
+	mIndexBuffer.assign(indices, indices + size / sizeof(uint16_t));
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ Vertex* SoftwareRenderDevice::MapVertexBuffer(size_t size)
+{
+	mVertexBuffer.resize(size / sizeof(Vertex));
+	return mVertexBuffer.data();
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ uint16_t* SoftwareRenderDevice::MapIndexBuffer(size_t size)
+{
+	mIndexBuffer.resize(size / sizeof(uint16_t));
+	return mIndexBuffer.data();
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::UnmapBuffers()
+{
+	// Written in place, nothing to hand back
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::SetVertexBuffer()
+{
+	// Only one buffer exists, nothing to bind
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::SetIndexBuffer()
+{
+	// Only one buffer exists, nothing to bind
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::SetConstantBuffers()
+{
+	// The camera is applied per vertex during rasterization
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::SetStyles(const Style* styles, size_t count)
+{
+	mStyles.assign(styles, styles + count);
+	mStylesRecorded = false;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void SoftwareRenderDevice::DrawIndexedTriangles(size_t indexCount, PrimitiveTopology topology)
+{
+	// Vertices are offsets from the camera's render origin, each is projected once however many triangles share it
+	double originX = 0.0;
+	double originY = 0.0;
+	mCamera.GetOrigin(originX, originY);
+	const float viewportWidth = static_cast<float>(mWidth);
+	const float viewportHeight = static_cast<float>(mHeight);
+	mScreenVertices.resize(mVertexBuffer.size());
+	for (size_t i = 0; i < mVertexBuffer.size(); ++i)
+	{
+		mCamera.WorldToScreen(originX + mVertexBuffer[i].x, originY + mVertexBuffer[i].y, viewportWidth, viewportHeight, mScreenVertices[i].x, mScreenVertices[i].y);
+	}
+
+	if (!mStylesRecorded)
+	{
+		mStyleBase = static_cast<uint32_t>(mFrameStyles.size());
+		mFrameStyles.insert(mFrameStyles.end(), mStyles.begin(), mStyles.end());
+		mStylesRecorded = true;
+	}
+
+	const size_t first = mTriangles.size();
+	indexCount = std::min(indexCount, mIndexBuffer.size());
+	if (topology == PrimitiveTopology::TriangleList)
+	{
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			AddTriangle(mIndexBuffer[i], mIndexBuffer[i + 1], mIndexBuffer[i + 2]);
+		}
+	}
+	else
+	{
+		size_t stripStart = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			if (mIndexBuffer[i] == kStripRestartIndex)
+			{
+				stripStart = i + 1;
+				continue;
+			}
+
+			if (i - stripStart < 2)
+			{
+				continue;
+			}
+
+			// Every other triangle swaps its first two vertices to keep the strip's winding
+			if ((i - stripStart) % 2 == 0)
+			{
+				AddTriangle(mIndexBuffer[i - 2], mIndexBuffer[i - 1], mIndexBuffer[i]);
+			}
+			else
+			{
+				AddTriangle(mIndexBuffer[i - 1], mIndexBuffer[i - 2], mIndexBuffer[i]);
+			}
+		}
+	}
+
+	AddCommand(CommandType::Triangles, first, mTriangles.size() - first);
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::AddTriangle(uint16_t i0, uint16_t i1, uint16_t i2)
+{
+	if (i0 >= mVertexBuffer.size() || i1 >= mVertexBuffer.size() || i2 >= mVertexBuffer.size())
+	{
+		ASSERT(false, "Index out of range");
+		return;
+	}
+
+	const uint32_t style0 = mVertexBuffer[i0].style;
+	const uint32_t style1 = mVertexBuffer[i1].style;
+	const uint32_t style2 = mVertexBuffer[i2].style;
+	if (style0 >= mStyles.size() || style1 >= mStyles.size() || style2 >= mStyles.size())
+	{
+		ASSERT(false, "Style out of range");
+		return;
+	}
+
+	mTriangles.emplace_back();
+	ScreenTriangle& triangle = mTriangles.back();
+	triangle.vertices[0] = mScreenVertices[i0];
+	triangle.vertices[1] = mScreenVertices[i1];
+	triangle.vertices[2] = mScreenVertices[i2];
+	triangle.styles[0] = mStyleBase + style0;
+	triangle.styles[1] = mStyleBase + style1;
+	triangle.styles[2] = mStyleBase + style2;
+	triangle.opaque = mStyles[style0].a >= 1.0f && mStyles[style1].a >= 1.0f && mStyles[style2].a >= 1.0f;
+	if (triangle.opaque)
+	{
+		// Only what can be on screen counts, at most the part of the bounding box inside the viewport
+		const ScreenVertex* v = triangle.vertices;
+		const float left = std::max(std::min({ v[0].x, v[1].x, v[2].x }), 0.0f);
+		const float top = std::max(std::min({ v[0].y, v[1].y, v[2].y }), 0.0f);
+		const float right = std::min(std::max({ v[0].x, v[1].x, v[2].x }), static_cast<float>(mWidth));
+		const float bottom = std::min(std::max({ v[0].y, v[1].y, v[2].y }), static_cast<float>(mHeight));
+		if (left < right && top < bottom)
+		{
+			const double area = std::abs(EdgeFunction(v[0].x, v[0].y, v[1].x, v[1].y, v[2].x, v[2].y)) * 0.5;
+			mOpaqueArea += std::min(area, static_cast<double>(right - left) * (bottom - top));
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool SoftwareRenderDevice::HasDirectRects() const
+{
+	return mCamera.IsAxisAligned();
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool SoftwareRenderDevice::HasDirectHairlines() const
+{
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool SoftwareRenderDevice::HasDirectMarkers() const
+{
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool SoftwareRenderDevice::FillRect(double x, double y, double width, double height, float r, float g, float b, float a)
+{
+	// A rotated camera turns the rect into an arbitrary quad, leave that to the triangle path
+	if (!mCamera.IsAxisAligned())
+	{
+		return false;
+	}
+
+	float x1 = 0.0f;
+	float y1 = 0.0f;
+	float x2 = 0.0f;
+	float y2 = 0.0f;
+	mCamera.WorldToScreen(x, y, static_cast<float>(mWidth), static_cast<float>(mHeight), x1, y1);
+	mCamera.WorldToScreen(x + width, y + height, static_cast<float>(mWidth), static_cast<float>(mHeight), x2, y2);
+
+	float left = std::min(x1, x2);
+	float right = std::max(x1, x2);
+	float top = std::min(y1, y2);
+	float bottom = std::max(y1, y2);
+
+	left = std::max(left, 0.0f);
+	top = std::max(top, 0.0f);
+	right = std::min(right, static_cast<float>(mWidth));
+	bottom = std::min(bottom, static_cast<float>(mHeight));
+
+	// Fully clipped, but still handled
+	if (!(left < right) || !(top < bottom))
+	{
+		return true;
+	}
+
+	ScreenRect rect;
+	rect.left = left;
+	rect.top = top;
+	rect.right = right;
+	rect.bottom = bottom;
+	rect.r = r;
+	rect.g = g;
+	rect.b = b;
+	rect.a = a;
+	mRects.push_back(rect);
+	AddCommand(CommandType::Rects, mRects.size() - 1, 1);
+	if (a >= 1.0f)
+	{
+		mOpaqueArea += (right - left) * (bottom - top);
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool SoftwareRenderDevice::DrawHairline(double x1, double y1, double x2, double y2, float width, float r, float g, float b, float a)
+{
+	const float viewportWidth = static_cast<float>(mWidth);
+	const float viewportHeight = static_cast<float>(mHeight);
+
+	// Clipped in world space first, so deep zooms don't project endpoints too far out for floats and pixel
+	// indices. The margin keeps the faded ends of a clipped line off screen.
+	const double pixelsPerUnitX = mCamera.GetPixelsPerUnit(viewportWidth);
+	const double pixelsPerUnitY = viewportHeight / AUTHORED_HEIGHT * mCamera.GetZoom();
+	Bounds visible = mCamera.GetVisibleBounds();
+	visible.Inflate(2.0 / std::min(pixelsPerUnitX, pixelsPerUnitY));
+	if (!ClipSegment(visible, x1, y1, x2, y2))
+	{
+		return true;
+	}
+
+	float ax = 0.0f;
+	float ay = 0.0f;
+	float bx = 0.0f;
+	float by = 0.0f;
+	mCamera.WorldToScreen(x1, y1, viewportWidth, viewportHeight, ax, ay);
+	mCamera.WorldToScreen(x2, y2, viewportWidth, viewportHeight, bx, by);
+
+	// Width across the line in pixels, by projecting the world-space normal
+	const double worldDX = x2 - x1;
+	const double worldDY = y2 - y1;
+	const double worldLength = std::sqrt(worldDX * worldDX + worldDY * worldDY);
+	double normalX = 0.0;
+	double normalY = 1.0;
+	if (worldLength > 0.0)
+	{
+		normalX = -worldDY / worldLength;
+		normalY = worldDX / worldLength;
+	}
+	float normalScreenX = 0.0f;
+	float normalScreenY = 0.0f;
+	mCamera.WorldToScreen(x1 + normalX, y1 + normalY, viewportWidth, viewportHeight, normalScreenX, normalScreenY);
+	const float pixelsPerUnit = std::sqrt((normalScreenX - ax) * (normalScreenX - ax) + (normalScreenY - ay) * (normalScreenY - ay));
+	const float pixelWidth = width * pixelsPerUnit;
+
+	if (!(pixelWidth <= 1.0f))
+	{
+		return false;
+	}
+
+	// Sub-pixel lines fade out by their coverage instead of dropping pixels
+	const float alpha = a * pixelWidth;
+	if (alpha <= 0.0f)
+	{
+		return true;
+	}
+
+	ScreenHairline hairline;
+	hairline.start.x = ax;
+	hairline.start.y = ay;
+	hairline.end.x = bx;
+	hairline.end.y = by;
+	hairline.r = r;
+	hairline.g = g;
+	hairline.b = b;
+	hairline.a = alpha;
+	mHairlines.push_back(hairline);
+	AddCommand(CommandType::Hairlines, mHairlines.size() - 1, 1);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool SoftwareRenderDevice::DrawMarkers(const Marker* markers, size_t count, MarkerShape shape, double originX, double originY)
+{
+	const bool square = shape == MarkerShape::Square;
+	if (square && mCamera.IsAxisAligned())
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Marker& marker = markers[i];
+			const float halfSize = marker.size * 0.5f;
+			FillRect(originX + marker.x - halfSize, originY + marker.y - halfSize, marker.size, marker.size, marker.r / 255.0f, marker.g / 255.0f, marker.b / 255.0f, marker.a / 255.0f);
+		}
+		return true;
+	}
+
+	const float viewportWidth = static_cast<float>(mWidth);
+	const float viewportHeight = static_cast<float>(mHeight);
+	const float pixelsPerUnit = static_cast<float>(mCamera.GetPixelsPerUnit(viewportWidth));
+
+	const size_t first = mMarkers.size();
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Marker& marker = markers[i];
+		mMarkers.emplace_back();
+		ScreenMarker& screenMarker = mMarkers.back();
+		mCamera.WorldToScreen(originX + marker.x, originY + marker.y, viewportWidth, viewportHeight, screenMarker.center.x, screenMarker.center.y);
+		screenMarker.radius = marker.size * 0.5f * pixelsPerUnit;
+		screenMarker.r = marker.r / 255.0f;
+		screenMarker.g = marker.g / 255.0f;
+		screenMarker.b = marker.b / 255.0f;
+		screenMarker.a = marker.a / 255.0f;
+	}
+
+	// Screen-space rotation of the marker's local frame, squares turn with the camera
+	DrawCommand& command = AddCommand(CommandType::Markers, first, count);
+	command.square = square;
+	command.cosRotation = std::cos(mCamera.GetRotation());
+	command.sinRotation = std::sin(mCamera.GetRotation());
+	return true;
+}
+
+//------------------------------------------------------------------------------
+SoftwareRenderDevice::DrawCommand& SoftwareRenderDevice::AddCommand(CommandType type, size_t first, size_t count)
+{
+	// Follows on from the last command when nothing came in between, markers carry state of their own
+	if (!mCommands.empty() && mCommands.back().type == type && type != CommandType::Markers)
+	{
+		mCommands.back().count += static_cast<uint32_t>(count);
+		mNextOrder += static_cast<uint32_t>(count);
+		return mCommands.back();
+	}
+
+	mCommands.emplace_back();
+	DrawCommand& command = mCommands.back();
+	command.type = type;
+	command.first = static_cast<uint32_t>(first);
+	command.count = static_cast<uint32_t>(count);
+	command.firstOrder = mNextOrder;
+	mNextOrder += static_cast<uint32_t>(count);
+	return command;
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::ClearFrame()
+{
+	mCommands.clear();
+	mTriangles.clear();
+	mRects.clear();
+	mHairlines.clear();
+	mMarkers.clear();
+	// The palette last drawn with carries over, so an unchanged palette isn't copied again every frame
+	if (mStylesRecorded)
+	{
+		mFrameStyles.erase(mFrameStyles.begin(), mFrameStyles.begin() + mStyleBase);
+		mStyleBase = 0;
+	}
+	else
+	{
+		mFrameStyles.clear();
+	}
+	mNextOrder = 1;
+	mOpaqueArea = 0.0;
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::ResolveFrame()
+{
+	// Opaque geometry goes first, front to back, each pixel taken by the first primitive to reach it. Under a
+	// screenful of it there is too little overdraw to make up for the bookkeeping, and everything is simply drawn
+	// in order.
+	mOcclusion = mOpaqueArea > static_cast<double>(mWidth) * mHeight;
+	if (mOcclusion)
+	{
+		mPixelOrders.assign(static_cast<size_t>(mWidth) * mHeight, 0);
+		mRowUncovered.assign(mHeight, static_cast<uint32_t>(mWidth));
+		mRowOrders.assign(mHeight, 0);
+		mTileColumns = (mWidth + kTileSize - 1) >> kTileShift;
+		const int32_t tileRows = (mHeight + kTileSize - 1) >> kTileShift;
+		mTileUncovered.resize(static_cast<size_t>(mTileColumns) * tileRows);
+		mTileOrders.assign(mTileUncovered.size(), 0);
+		mNextOpenTiles.resize(mTileUncovered.size());
+		for (int32_t row = 0; row < tileRows; ++row)
+		{
+			for (int32_t column = 0; column < mTileColumns; ++column)
+			{
+				const int32_t width = std::min(kTileSize, mWidth - (column << kTileShift));
+				const int32_t height = std::min(kTileSize, mHeight - (row << kTileShift));
+				mTileUncovered[static_cast<size_t>(row) * mTileColumns + column] = static_cast<uint8_t>(width * height);
+				mNextOpenTiles[static_cast<size_t>(row) * mTileColumns + column] = column;
+			}
+		}
+
+		for (auto it = mCommands.rbegin(); it != mCommands.rend(); ++it)
+		{
+			ResolveCommand(*it, true);
+		}
+	}
+
+	// Then the rest in the order it was drawn, blended over the opaque geometry behind it
+	for (const DrawCommand& command : mCommands)
+	{
+		ResolveCommand(command, false);
+	}
+
+	mOcclusion = false;
+	ClearFrame();
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::ResolveCommand(const DrawCommand& command, bool opaquePass)
+{
+	// The opaque pass goes through each command backwards as well, only the opaque parts of the primitives are
+	// drawn in it and only the rest in the translucent pass
+	for (uint32_t i = 0; i < command.count; ++i)
+	{
+		const uint32_t index = opaquePass ? command.count - 1 - i : i;
+		const uint32_t order = command.firstOrder + index;
+		switch (command.type)
+		{
+		case CommandType::Triangles:
+		{
+			const ScreenTriangle& triangle = mTriangles[command.first + index];
+			if (triangle.opaque == opaquePass || !mOcclusion)
+			{
+				RasterizeTriangle(triangle, order, opaquePass);
+			}
+			break;
+		}
+		case CommandType::Rects:
+		{
+			RasterizeRect(mRects[command.first + index], order, opaquePass);
+			break;
+		}
+		case CommandType::Hairlines:
+		{
+			if (!opaquePass)
+			{
+				RasterizeHairline(mHairlines[command.first + index], order);
+			}
+			break;
+		}
+		case CommandType::Markers:
+		{
+			if (!opaquePass)
+			{
+				RasterizeMarker(mMarkers[command.first + index], command, order);
+			}
+			break;
+		}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::RasterizeTriangle(const ScreenTriangle& triangle, uint32_t order, bool opaquePass)
+{
+	float x0 = triangle.vertices[0].x;
+	float y0 = triangle.vertices[0].y;
+	float x1 = triangle.vertices[1].x;
+	float y1 = triangle.vertices[1].y;
+	float x2 = triangle.vertices[2].x;
+	float y2 = triangle.vertices[2].y;
+	const Style* c0 = &mFrameStyles[triangle.styles[0]];
+	const Style* c1 = &mFrameStyles[triangle.styles[1]];
+	const Style* c2 = &mFrameStyles[triangle.styles[2]];
+
+	// Shapes use one style for all their vertices, which needs no interpolation
+	const bool flat = triangle.styles[0] == triangle.styles[1] && triangle.styles[0] == triangle.styles[2];
+
+	float area = EdgeFunction(x0, y0, x1, y1, x2, y2);
+	if (!(area != 0.0f) || !std::isfinite(area))
+	{
+		// Degenerate or NaN
+		return;
+	}
+
+	// Keep a consistent winding so edge ownership is well defined
+	if (area < 0.0f)
+	{
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+		std::swap(c1, c2);
+		area = -area;
+	}
+
+	const int32_t minX = ClampToPixel(std::floor(std::min({ x0, x1, x2 })), 0, mWidth);
+	const int32_t minY = ClampToPixel(std::floor(std::min({ y0, y1, y2 })), 0, mHeight);
+	const int32_t maxX = ClampToPixel(std::ceil(std::max({ x0, x1, x2 })), -1, mWidth - 1);
+	const int32_t maxY = ClampToPixel(std::ceil(std::max({ y0, y1, y2 })), -1, mHeight - 1);
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	const bool owns0 = OwnsEdge(x1, y1, x2, y2);
+	const bool owns1 = OwnsEdge(x2, y2, x0, y0);
+	const bool owns2 = OwnsEdge(x0, y0, x1, y1);
+
+	// Per-pixel step of each edge function along x
+	const float step0 = -(y2 - y1);
+	const float step1 = -(y0 - y2);
+	const float step2 = -(y1 - y0);
+
+	// The opaque pass counts covered pixels tile by tile, the translucent pass only checks tiles one by one in
+	// triangles wide enough to span several of them
+	const bool splitTiles = mOcclusion && (opaquePass || maxX - minX >= kTileSize * 4);
+
+	// A flat opaque triangle overwrites every pixel it takes with the same color
+	const uint32_t flatColor = ToColor(c0->r, c0->g, c0->b, 1.0f);
+	const bool overwrite = flat && triangle.opaque;
+
+	const float invArea = 1.0f / area;
+	for (int32_t py = minY; py <= maxY; ++py)
+	{
+		if (mOcclusion && IsRowHidden(py, order, opaquePass))
+		{
+			continue;
+		}
+
+		const float sampleX = minX + 0.5f;
+		const float sampleY = py + 0.5f;
+		float w0 = EdgeFunction(x1, y1, x2, y2, sampleX, sampleY);
+		float w1 = EdgeFunction(x2, y2, x0, y0, sampleX, sampleY);
+		float w2 = EdgeFunction(x0, y0, x1, y1, sampleX, sampleY);
+
+		uint32_t* row = mFramebuffer.data() + static_cast<size_t>(py) * mWidth;
+		uint32_t* orders = mOcclusion ? mPixelOrders.data() + static_cast<size_t>(py) * mWidth : nullptr;
+		const size_t tileRow = static_cast<size_t>(py >> kTileShift) * mTileColumns;
+		for (int32_t px = minX; px <= maxX;)
+		{
+			// Hidden tiles are passed over whole, the edge functions still step pixel by pixel so the pixels that
+			// are drawn come out exactly the same
+			const int32_t tileLast = splitTiles ? std::min(px | (kTileSize - 1), maxX) : maxX;
+			if (splitTiles && IsTileHidden(tileRow + (px >> kTileShift), order, opaquePass))
+			{
+				for (; px <= tileLast; ++px)
+				{
+					w0 += step0;
+					w1 += step1;
+					w2 += step2;
+				}
+				continue;
+			}
+
+			const int32_t tileFirst = px;
+			uint32_t covered = 0;
+			for (; px <= tileLast; ++px, w0 += step0, w1 += step1, w2 += step2)
+			{
+				const bool inside0 = w0 > 0.0f || (w0 == 0.0f && owns0);
+				const bool inside1 = w1 > 0.0f || (w1 == 0.0f && owns1);
+				const bool inside2 = w2 > 0.0f || (w2 == 0.0f && owns2);
+				if (!inside0 || !inside1 || !inside2)
+				{
+					continue;
+				}
+
+				// Opaque geometry takes free pixels, translucent geometry only shows in front of what took them
+				if (orders != nullptr)
+				{
+					if (!opaquePass)
+					{
+						if (orders[px] > order)
+						{
+							continue;
+						}
+					}
+					else
+					{
+						if (orders[px] != 0)
+						{
+							continue;
+						}
+						orders[px] = order;
+						++covered;
+					}
+				}
+
+				if (overwrite)
+				{
+					row[px] = flatColor;
+					continue;
+				}
+				if (flat)
+				{
+					BlendPixel(row[px], c0->r, c0->g, c0->b, c0->a);
+					continue;
+				}
+
+				const float b0 = w0 * invArea;
+				const float b1 = w1 * invArea;
+				const float b2 = w2 * invArea;
+				BlendPixel(row[px],
+					b0 * c0->r + b1 * c1->r + b2 * c2->r,
+					b0 * c0->g + b1 * c1->g + b2 * c2->g,
+					b0 * c0->b + b1 * c1->b + b2 * c2->b,
+					b0 * c0->a + b1 * c1->a + b2 * c2->a);
+			}
+			if (covered != 0)
+			{
+				CoverPixels(tileFirst, py, covered, order);
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::RasterizeRect(const ScreenRect& rect, uint32_t order, bool opaquePass)
+{
+	const int32_t firstRow = static_cast<int32_t>(rect.top);
+	const int32_t lastRow = static_cast<int32_t>(std::ceil(rect.bottom)) - 1;
+	for (int32_t row = firstRow; row <= lastRow; ++row)
+	{
+		// Fractional coverage of the top and bottom borders
+		const float rowCoverage = std::min(rect.bottom, row + 1.0f) - std::max(rect.top, static_cast<float>(row));
+		FillRectRow(row, rect.left, rect.right, rect.r, rect.g, rect.b, rect.a * rowCoverage, order, opaquePass);
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::RasterizeHairline(const ScreenHairline& hairline, uint32_t order)
+{
+	const float r = hairline.r;
+	const float g = hairline.g;
+	const float b = hairline.b;
+	const float alpha = hairline.a;
+
+	// Xiaolin Wu's algorithm, working with pixel centers at integer coordinates
+	float ax = hairline.start.x - 0.5f;
+	float ay = hairline.start.y - 0.5f;
+	float bx = hairline.end.x - 0.5f;
+	float by = hairline.end.y - 0.5f;
+
+	const bool steep = std::abs(by - ay) > std::abs(bx - ax);
+	if (steep)
+	{
+		std::swap(ax, ay);
+		std::swap(bx, by);
+	}
+	if (ax > bx)
+	{
+		std::swap(ax, bx);
+		std::swap(ay, by);
+	}
+
+	const float dx = bx - ax;
+	const float gradient = dx > 0.0f ? (by - ay) / dx : 1.0f;
+
+	// First endpoint
+	const float startX = std::round(ax);
+	const float startY = ay + gradient * (startX - ax);
+	const float startGap = 1.0f - ((ax + 0.5f) - std::floor(ax + 0.5f));
+	const int32_t startPixel = static_cast<int32_t>(startX);
+	const float startFrac = startY - std::floor(startY);
+	PlotHairlinePixel(startPixel, static_cast<int32_t>(std::floor(startY)), steep, r, g, b, alpha * (1.0f - startFrac) * startGap, order);
+	PlotHairlinePixel(startPixel, static_cast<int32_t>(std::floor(startY)) + 1, steep, r, g, b, alpha * startFrac * startGap, order);
+
+	// Second endpoint
+	const float endX = std::round(bx);
+	const float endY = by + gradient * (endX - bx);
+	const float endGap = (bx + 0.5f) - std::floor(bx + 0.5f);
+	const int32_t endPixel = static_cast<int32_t>(endX);
+	const float endFrac = endY - std::floor(endY);
+	if (endPixel != startPixel)
+	{
+		PlotHairlinePixel(endPixel, static_cast<int32_t>(std::floor(endY)), steep, r, g, b, alpha * (1.0f - endFrac) * endGap, order);
+		PlotHairlinePixel(endPixel, static_cast<int32_t>(std::floor(endY)) + 1, steep, r, g, b, alpha * endFrac * endGap, order);
+	}
+
+	// Span between the endpoints, clipped to the framebuffer along the major axis
+	const int32_t majorLimit = steep ? mHeight : mWidth;
+	const int32_t first = std::max(startPixel + 1, 0);
+	const int32_t last = std::min(endPixel - 1, majorLimit - 1);
+	float intersectY = startY + gradient * (first - startPixel);
+	for (int32_t x = first; x <= last; ++x, intersectY += gradient)
+	{
+		const float floorY = std::floor(intersectY);
+		const float frac = intersectY - floorY;
+		PlotHairlinePixel(x, static_cast<int32_t>(floorY), steep, r, g, b, alpha * (1.0f - frac), order);
+		PlotHairlinePixel(x, static_cast<int32_t>(floorY) + 1, steep, r, g, b, alpha * frac, order);
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::RasterizeMarker(const ScreenMarker& marker, const DrawCommand& command, uint32_t order)
+{
+	// Analytic coverage, same as MarkerPixelShader
+	const float centerX = marker.center.x;
+	const float centerY = marker.center.y;
+	const float radius = marker.radius;
+	const float extent = (command.square ? radius * 1.415f : radius) + 1.0f;
+
+	const int32_t minX = ClampToPixel(std::floor(centerX - extent), 0, mWidth);
+	const int32_t minY = ClampToPixel(std::floor(centerY - extent), 0, mHeight);
+	const int32_t maxX = ClampToPixel(std::ceil(centerX + extent), -1, mWidth - 1);
+	const int32_t maxY = ClampToPixel(std::ceil(centerY + extent), -1, mHeight - 1);
+	for (int32_t py = minY; py <= maxY; ++py)
+	{
+		const float dy = py + 0.5f - centerY;
+		uint32_t* row = mFramebuffer.data() + static_cast<size_t>(py) * mWidth;
+		for (int32_t px = minX; px <= maxX; ++px)
+		{
+			const float dx = px + 0.5f - centerX;
+			float edgeDistance = 0.0f;
+			if (command.square)
+			{
+				const float localX = command.cosRotation * dx + command.sinRotation * dy;
+				const float localY = -command.sinRotation * dx + command.cosRotation * dy;
+				edgeDistance = std::max(std::abs(localX), std::abs(localY));
+			}
+			else
+			{
+				edgeDistance = std::sqrt(dx * dx + dy * dy);
+			}
+
+			const float coverage = std::min(std::max(radius - edgeDistance + 0.5f, 0.0f), 1.0f);
+			if (coverage > 0.0f && IsPixelVisible(px, py, order, false))
+			{
+				BlendPixel(row[px], marker.r, marker.g, marker.b, marker.a * coverage);
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::PlotHairlinePixel(int32_t x, int32_t y, bool steep, float r, float g, float b, float a, uint32_t order)
+{
+	if (steep)
+	{
+		std::swap(x, y);
+	}
+	if (x < 0 || y < 0 || x >= mWidth || y >= mHeight || !IsPixelVisible(x, y, order, false))
+	{
+		return;
+	}
+
+	BlendPixel(mFramebuffer[static_cast<size_t>(y) * mWidth + x], r, g, b, a);
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::FillRectRow(int32_t y, float left, float right, float r, float g, float b, float a, uint32_t order, bool opaquePass)
+{
+	const int32_t firstCol = static_cast<int32_t>(left);
+	const int32_t lastCol = static_cast<int32_t>(std::ceil(right)) - 1;
+
+	// Only the interior of a fully covered row at full alpha is opaque, the borders are partially covered
+	const bool opaqueInterior = a >= 1.0f && lastCol - firstCol > 1;
+	if (opaquePass)
+	{
+		if (opaqueInterior)
+		{
+			FillOpaqueSpan(y, firstCol + 1, lastCol - 1, ToColor(r, g, b, 1.0f), order);
+		}
+		return;
+	}
+
+	uint32_t* row = mFramebuffer.data() + static_cast<size_t>(y) * mWidth;
+	if (firstCol == lastCol)
+	{
+		if (IsPixelVisible(firstCol, y, order, false))
+		{
+			BlendPixel(row[firstCol], r, g, b, a * (right - left));
+		}
+		return;
+	}
+
+	// Fractional coverage of the left and right borders
+	if (IsPixelVisible(firstCol, y, order, false))
+	{
+		BlendPixel(row[firstCol], r, g, b, a * (firstCol + 1.0f - left));
+	}
+	if (IsPixelVisible(lastCol, y, order, false))
+	{
+		BlendPixel(row[lastCol], r, g, b, a * (right - lastCol));
+	}
+
+	if (opaqueInterior)
+	{
+		if (!mOcclusion)
+		{
+			FillSpan(row + firstCol + 1, lastCol - firstCol - 1, ToColor(r, g, b, 1.0f));
+		}
+	}
+	else if (lastCol - firstCol > 1)
+	{
+		BlendVisibleSpan(y, firstCol + 1, lastCol - 1, r, g, b, a, order);
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::FillOpaqueSpan(int32_t y, int32_t first, int32_t last, uint32_t color, uint32_t order)
+{
+	if (IsRowHidden(y, order, true))
+	{
+		return;
+	}
+
+	uint32_t* row = mFramebuffer.data() + static_cast<size_t>(y) * mWidth;
+	uint32_t* orders = mPixelOrders.data() + static_cast<size_t>(y) * mWidth;
+	const size_t tileRow = static_cast<size_t>(y >> kTileShift) * mTileColumns;
+	for (int32_t x = first; x <= last;)
+	{
+		// Covered tiles are passed over in one go
+		const int32_t column = FindOpenTile(tileRow, x >> kTileShift);
+		if (column > (last >> kTileShift))
+		{
+			break;
+		}
+		x = std::max(x, column << kTileShift);
+
+		const int32_t tileLast = std::min(x | (kTileSize - 1), last);
+		const size_t tile = tileRow + column;
+
+		// Nothing in an untouched tile needs checking
+		if (mTileUncovered[tile] == kTileSize * kTileSize)
+		{
+			const int32_t count = tileLast - x + 1;
+			FillSpan(row + x, count, color);
+			std::fill(orders + x, orders + tileLast + 1, order);
+			CoverPixels(x, y, static_cast<uint32_t>(count), order);
+			x = tileLast + 1;
+			continue;
+		}
+
+		const int32_t tileFirst = x;
+		uint32_t covered = 0;
+		for (; x <= tileLast; ++x)
+		{
+			if (orders[x] == 0)
+			{
+				orders[x] = order;
+				row[x] = color;
+				++covered;
+			}
+		}
+		CoverPixels(tileFirst, y, covered, order);
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::BlendVisibleSpan(int32_t y, int32_t first, int32_t last, float r, float g, float b, float a, uint32_t order)
+{
+	uint32_t* row = mFramebuffer.data() + static_cast<size_t>(y) * mWidth;
+	if (!mOcclusion)
+	{
+		BlendSpan(row + first, last - first + 1, r, g, b, a);
+		return;
+	}
+
+	// Blended in runs between the pixels that opaque geometry in front has taken
+	const uint32_t* orders = mPixelOrders.data() + static_cast<size_t>(y) * mWidth;
+	int32_t x = first;
+	while (x <= last)
+	{
+		while (x <= last && orders[x] > order)
+		{
+			++x;
+		}
+		const int32_t runStart = x;
+		while (x <= last && orders[x] < order)
+		{
+			++x;
+		}
+		if (x > runStart)
+		{
+			BlendSpan(row + runStart, x - runStart, r, g, b, a);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::FillSpan(uint32_t* dst, int32_t count, uint32_t color)
+{
+	const __m128i color4 = _mm_set1_epi32(static_cast<int32_t>(color));
+
+	int32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), color4);
+	}
+	for (; i < count; ++i)
+	{
+		dst[i] = color;
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::BlendSpan(uint32_t* dst, int32_t count, float r, float g, float b, float a)
+{
+	const uint16_t alpha = ToBlendFactor(a);
+	if (alpha == 0)
+	{
+		return;
+	}
+
+	// dst = (src * alpha + dst * (256 - alpha)) >> 8, per 16-bit channel, two pixels per register half
+	const uint16_t srcR = ToChannel(r) * alpha;
+	const uint16_t srcG = ToChannel(g) * alpha;
+	const uint16_t srcB = ToChannel(b) * alpha;
+	const uint16_t srcA = 255 * alpha;
+	const __m128i src = _mm_set_epi16(srcA, srcR, srcG, srcB, srcA, srcR, srcG, srcB);
+	const __m128i invAlpha = _mm_set1_epi16(static_cast<int16_t>(256 - alpha));
+	const __m128i zero = _mm_setzero_si128();
+
+	int32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i* pixels = reinterpret_cast<__m128i*>(dst + i);
+		const __m128i packed = _mm_loadu_si128(pixels);
+
+		__m128i low = _mm_unpacklo_epi8(packed, zero);
+		__m128i high = _mm_unpackhi_epi8(packed, zero);
+		low = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(low, invAlpha), src), 8);
+		high = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(high, invAlpha), src), 8);
+
+		_mm_storeu_si128(pixels, _mm_packus_epi16(low, high));
+	}
+	for (; i < count; ++i)
+	{
+		BlendPixel(dst[i], r, g, b, a);
+	}
+}
+
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::BlendPixel(uint32_t& dst, float r, float g, float b, float a)
+{
+	const uint32_t alpha = ToBlendFactor(a);
+	if (alpha == 0)
+	{
+		return;
+	}
+	if (alpha == 256)
+	{
+		dst = ToColor(r, g, b, 1.0f);
+		return;
+	}
+
+	const uint32_t invAlpha = 256 - alpha;
+	const uint32_t dstR = (dst >> 16) & 0xFF;
+	const uint32_t dstG = (dst >> 8) & 0xFF;
+	const uint32_t dstB = dst & 0xFF;
+	const uint32_t outR = (ToChannel(r) * alpha + dstR * invAlpha) >> 8;
+	const uint32_t outG = (ToChannel(g) * alpha + dstG * invAlpha) >> 8;
+	const uint32_t outB = (ToChannel(b) * alpha + dstB * invAlpha) >> 8;
+	dst = 0xFF000000u | (outR << 16) | (outG << 8) | outB;
+}
+
+//------------------------------------------------------------------------------
+bool SoftwareRenderDevice::IsTileHidden(size_t tile, uint32_t order, bool opaquePass) const
+{
+	return IsCoveredFor(mTileUncovered[tile], mTileOrders[tile], order, opaquePass);
+}
+
+//------------------------------------------------------------------------------
+bool SoftwareRenderDevice::IsRowHidden(int32_t y, uint32_t order, bool opaquePass) const
+{
+	return IsCoveredFor(mRowUncovered[y], mRowOrders[y], order, opaquePass);
+}
+
+// Whether a primitive of the given order shows on the pixel. In the opaque pass the primitive also takes the pixel
+// if it is still free, in the translucent pass it only shows in front of the opaque primitive that took it.
+//------------------------------------------------------------------------------
+bool SoftwareRenderDevice::IsPixelVisible(int32_t x, int32_t y, uint32_t order, bool opaquePass)
+{
+	if (!mOcclusion)
+	{
+		return true;
+	}
+
+	uint32_t& pixelOrder = mPixelOrders[static_cast<size_t>(y) * mWidth + x];
+	if (!opaquePass)
+	{
+		return pixelOrder < order;
+	}
+	if (pixelOrder != 0)
+	{
+		return false;
+	}
+
+	pixelOrder = order;
+	CoverPixels(x, y, 1, order);
+	return true;
+}
+
+// First column from the given one in the tile row with pixels still uncovered, or the column count if there is
+// none. Covered tiles link to the next column, and the links are shortened to point straight at the result.
+//------------------------------------------------------------------------------
+int32_t SoftwareRenderDevice::FindOpenTile(size_t tileRow, int32_t column)
+{
+	int32_t open = column;
+	while (open < mTileColumns && mNextOpenTiles[tileRow + open] != open)
+	{
+		open = mNextOpenTiles[tileRow + open];
+	}
+	while (column < open)
+	{
+		const int32_t next = mNextOpenTiles[tileRow + column];
+		mNextOpenTiles[tileRow + column] = open;
+		column = next;
+	}
+	return open;
+}
+
+// Counts pixels of one row within one tile as taken. The opaque pass goes front to back, so whatever covers the
+// last pixel of a tile or row is behind everything else on it.
+//------------------------------------------------------------------------------
+void SoftwareRenderDevice::CoverPixels(int32_t x, int32_t y, uint32_t count, uint32_t order)
+{
+	const size_t tile = static_cast<size_t>(y >> kTileShift) * mTileColumns + (x >> kTileShift);
+	mTileUncovered[tile] = static_cast<uint8_t>(mTileUncovered[tile] - count);
+	if (mTileUncovered[tile] == 0)
+	{
+		mTileOrders[tile] = order;
+		mNextOpenTiles[tile] = (x >> kTileShift) + 1;
+	}
+
+	mRowUncovered[y] -= count;
+	if (mRowUncovered[y] == 0)
+	{
+		mRowOrders[y] = order;
+	}
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "Camera.h"
+#include "IRenderDevice.h"
+
+// External
+#include <windows.h>
+
+// System
+#include <vector>
+
+// CPU rasterizer that renders into a system memory framebuffer and blits it to the window with GDI. Draws are
+// recorded in screen space as they arrive and rasterized when the frame is presented: opaque geometry first, front
+// to back, so nothing it hides is ever shaded, then the translucent geometry back to front over it.
+//------------------------------------------------------------------------------
+class SoftwareRenderDevice : public IRenderDevice
+{
+public:
+	SoftwareRenderDevice();
+	~SoftwareRenderDevice();
+
+	virtual bool Initialize(void* windowHandle, int32_t width, int32_t height) override;
+	virtual void Resize(int32_t width, int32_t height) override;
+	virtual void PreRender() override;
+	virtual void Render() override;
+	virtual void Shutdown() override;
+	virtual int32_t GetWidth() const override { return mWidth; }
+	virtual int32_t GetHeight() const override { return mHeight; }
+
+	virtual void SetCamera(const Camera& camera) override { mCamera = camera; }
+	virtual const Camera& GetCamera() const override { return mCamera; }
+
+	virtual bool LoadShaders() override;
+
+	virtual void CreateVertexBuffer(const Vertex* vertices, size_t size) override;
+	virtual void CreateIndexBuffer(const uint16_t* indices, size_t size) override;
+	virtual Vertex* MapVertexBuffer(size_t size) override;
+	virtual uint16_t* MapIndexBuffer(size_t size) override;
+	virtual void UnmapBuffers() override;
+	virtual void SetVertexBuffer() override;
+	virtual void SetIndexBuffer() override;
+	virtual void SetConstantBuffers() override;
+	virtual void SetStyles(const Style* styles, size_t count) override;
+	virtual void DrawIndexedTriangles(size_t indexCount, PrimitiveTopology topology) override;
+
+	virtual bool HasDirectRects() const override;
+	virtual bool HasDirectHairlines() const override;
+	virtual bool HasDirectMarkers() const override;
+	virtual bool FillRect(double x, double y, double width, double height, float r, float g, float b, float a) override;
+	virtual bool DrawHairline(double x1, double y1, double x2, double y2, float width, float r, float g, float b, float a) override;
+	virtual bool DrawMarkers(const Marker* markers, size_t count, MarkerShape shape, double originX, double originY) override;
+
+private:
+	enum class CommandType
+	{
+		Triangles,
+		Rects,
+		Hairlines,
+		Markers
+	};
+
+	// Run of primitives of one type stored in the frame's arrays. Every primitive has its own order in the frame,
+	// consecutive from the command's first.
+	struct DrawCommand
+	{
+		CommandType type = CommandType::Triangles;
+		uint32_t first = 0;
+		uint32_t count = 0;
+		uint32_t firstOrder = 0;
+
+		// Markers
+		bool square = false;
+		float cosRotation = 1.0f;
+		float sinRotation = 0.0f;
+	};
+
+	struct ScreenVertex
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+	};
+
+	// Styles index the frame's styles. Opaque when every vertex is, so every pixel it covers is too.
+	struct ScreenTriangle
+	{
+		ScreenVertex vertices[3];
+		uint32_t styles[3] = {};
+		bool opaque = false;
+	};
+
+	// Clipped to the framebuffer
+	struct ScreenRect
+	{
+		float left = 0.0f;
+		float top = 0.0f;
+		float right = 0.0f;
+		float bottom = 0.0f;
+		float r = 0.0f;
+		float g = 0.0f;
+		float b = 0.0f;
+		float a = 0.0f;
+	};
+
+	// Alpha already scaled by the coverage of the sub-pixel width
+	struct ScreenHairline
+	{
+		ScreenVertex start;
+		ScreenVertex end;
+		float r = 0.0f;
+		float g = 0.0f;
+		float b = 0.0f;
+		float a = 0.0f;
+	};
+
+	struct ScreenMarker
+	{
+		ScreenVertex center;
+		float radius = 0.0f;
+		float r = 0.0f;
+		float g = 0.0f;
+		float b = 0.0f;
+		float a = 0.0f;
+	};
+
+	void AddTriangle(uint16_t i0, uint16_t i1, uint16_t i2);
+	DrawCommand& AddCommand(CommandType type, size_t first, size_t count);
+	void ClearFrame();
+	void ResolveFrame();
+	void ResolveCommand(const DrawCommand& command, bool opaquePass);
+	void RasterizeTriangle(const ScreenTriangle& triangle, uint32_t order, bool opaquePass);
+	void RasterizeRect(const ScreenRect& rect, uint32_t order, bool opaquePass);
+	void RasterizeHairline(const ScreenHairline& hairline, uint32_t order);
+	void RasterizeMarker(const ScreenMarker& marker, const DrawCommand& command, uint32_t order);
+	void PlotHairlinePixel(int32_t x, int32_t y, bool steep, float r, float g, float b, float a, uint32_t order);
+	void FillRectRow(int32_t y, float left, float right, float r, float g, float b, float a, uint32_t order, bool opaquePass);
+	void FillOpaqueSpan(int32_t y, int32_t first, int32_t last, uint32_t color, uint32_t order);
+	void BlendVisibleSpan(int32_t y, int32_t first, int32_t last, float r, float g, float b, float a, uint32_t order);
+	void FillSpan(uint32_t* dst, int32_t count, uint32_t color);
+	void BlendSpan(uint32_t* dst, int32_t count, float r, float g, float b, float a);
+	void BlendPixel(uint32_t& dst, float r, float g, float b, float a);
+	bool IsTileHidden(size_t tile, uint32_t order, bool opaquePass) const;
+	bool IsRowHidden(int32_t y, uint32_t order, bool opaquePass) const;
+	bool IsPixelVisible(int32_t x, int32_t y, uint32_t order, bool opaquePass);
+	int32_t FindOpenTile(size_t tileRow, int32_t column);
+	void CoverPixels(int32_t x, int32_t y, uint32_t count, uint32_t order);
+
+	HWND mHWND = 0;
+	int32_t mWidth = 0;
+	int32_t mHeight = 0;
+
+	Camera mCamera;
+
+	// 32-bit BGRA, top-down rows
+	std::vector<uint32_t> mFramebuffer;
+
+	std::vector<Vertex> mVertexBuffer;
+	std::vector<uint16_t> mIndexBuffer;
+	std::vector<Style> mStyles;
+
+	// The frame so far, in submission order. Each palette set is copied in once it is first drawn with.
+	std::vector<DrawCommand> mCommands;
+	std::vector<ScreenTriangle> mTriangles;
+	std::vector<ScreenRect> mRects;
+	std::vector<ScreenHairline> mHairlines;
+	std::vector<ScreenMarker> mMarkers;
+	std::vector<Style> mFrameStyles;
+	std::vector<ScreenVertex> mScreenVertices;
+	uint32_t mStyleBase = 0;
+	bool mStylesRecorded = false;
+	uint32_t mNextOrder = 1;
+	double mOpaqueArea = 0.0;
+
+	// Order of the front-most opaque primitive on each pixel, zero where there is none. Tiles and rows count the
+	// pixels still uncovered, and once there are none keep the order of the primitive that covered the last one.
+	bool mOcclusion = false;
+	std::vector<uint32_t> mPixelOrders;
+	std::vector<uint8_t> mTileUncovered;
+	std::vector<uint32_t> mTileOrders;
+	std::vector<int32_t> mNextOpenTiles;
+	std::vector<uint32_t> mRowUncovered;
+	std::vector<uint32_t> mRowOrders;
+	int32_t mTileColumns = 0;
+};
@@ -3,48 +3,1551 @@
 // Renderer
 #include <Renderer/IRenderDevice.h>
 
+// Utils
+#include <Utils/Assert.h>
+#include <Utils/RadixSort.h>
+
 // Vector
 #include <Vector/VectorShape.h>
 
+// System
+#include <algorithm>
+#include <cmath>
+
+// Shapes smaller than this on screen are collapsed into coverage cells
+static const double kCoverageCellPixels = 1.0;
+
+// Cells fainter than one 8-bit step are dropped
+static const float kMinCoverage = 1.0f / 255.0f;
+
+// Rebuild work is measured in estimated vertices, plus a fixed cost per shape for the size query and setup
+static const size_t kRebuildShapeCost = 16;
+
+// Below this much work per thread, handing it to a worker costs more than it saves
+static const size_t kMinRebuildCostPerThread = 16384;
+
+// Batches a shape looks back through for one to join, bounds the cost of batching
+static const size_t kMaxBatchLookback = 32;
+
+// 16-bit indices, the largest value is the strip restart
+static const size_t kMaxBatchVertices = kStripRestartIndex;
+
+// Cells across each side of the view when placing batches on layers, overlap is tested per cell. Fits in the
+// byte each edge of a shape's cell range is packed into.
+static const uint32_t kLayerGridCells = 32;
+
+// Draw key fields below the layer, from the most significant: pipeline, resource (the group) and the batch index
+static const uint32_t kDrawKeyPipelineBits = 2;
+static const uint32_t kDrawKeyResourceBits = 14;
+static const uint32_t kDrawKeySequenceBits = 24;
+static const uint32_t kDrawKeyStateBits = kDrawKeyPipelineBits + kDrawKeyResourceBits;
+static const uint64_t kDrawKeySequenceMask = (uint64_t(1) << kDrawKeySequenceBits) - 1;
+
+//------------------------------------------------------------------------------
+template <typename Params>
+static void CopyStroke(const Params& params, IVectorShape& shape)
+{
+	shape.strokeWidth = params.strokeWidth;
+	shape.strokeR = params.stroke.r;
+	shape.strokeG = params.stroke.g;
+	shape.strokeB = params.stroke.b;
+	shape.strokeA = params.stroke.a;
+}
+
+//------------------------------------------------------------------------------
+// Builds a shape from packed parameters for bulk submission, setting the style fields without the virtual setters
+static Rect* ConstructShape(ShapePool<Rect>& pool, const VectorRenderer::RectParams& params)
+{
+	Rect* rect = pool.Create(params.x, params.y, params.width, params.height);
+	rect->fillR = params.fill.r;
+	rect->fillG = params.fill.g;
+	rect->fillB = params.fill.b;
+	rect->fillA = params.fill.a;
+	return rect;
+}
+
+//------------------------------------------------------------------------------
+static Line* ConstructShape(ShapePool<Line>& pool, const VectorRenderer::LineParams& params)
+{
+	Line* line = pool.Create(params.x1, params.y1, params.x2, params.y2);
+	CopyStroke(params, *line);
+	return line;
+}
+
+//------------------------------------------------------------------------------
+static BezierCurve* ConstructShape(ShapePool<BezierCurve>& pool, const VectorRenderer::BezierCurveParams& params)
+{
+	BezierCurve* curve = pool.Create(params.x1, params.y1, params.x2, params.y2, params.cx1, params.cy1);
+	CopyStroke(params, *curve);
+	return curve;
+}
+
+//------------------------------------------------------------------------------
+static CubicBezierCurve* ConstructShape(ShapePool<CubicBezierCurve>& pool, const VectorRenderer::CubicBezierCurveParams& params)
+{
+	CubicBezierCurve* curve = pool.Create(params.x1, params.y1, params.x2, params.y2, params.cx1, params.cy1, params.cx2, params.cy2);
+	CopyStroke(params, *curve);
+	return curve;
+}
+
+//------------------------------------------------------------------------------
+VectorRenderer::VectorRenderer(IRenderDevice* renderer)
+	: mRenderDevice(renderer)
+	, mThreadPool(ThreadPool::GetShared())
+	, mCoverageMarkers(MarkerShape::Square)
+{
+}
+
+//------------------------------------------------------------------------------
+VectorRenderer::~VectorRenderer()
+{
+	ClearShapes();
+}
+
+//------------------------------------------------------------------------------
+ShapeHandle VectorRenderer::AddShape(const IVectorShape* shape)
+{
+	ASSERT(!mExternalHandles, "Adding a shape to a renderer whose handles are assigned by the caller");
+
+	uint32_t index = kNoSlot;
+	if (!mFreeSlots.empty())
+	{
+		index = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(mSlots.size());
+		mSlots.emplace_back();
+		mSlots.back().generation = mNextGeneration;
+	}
+
+	mSlots[index].shape = shape;
+	LinkSlot(index);
+
+	ShapeHandle handle;
+	handle.index = index;
+	handle.generation = mSlots[index].generation;
+	return handle;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::InsertShape(ShapeHandle handle, const IVectorShape* shape)
+{
+	mExternalHandles = true;
+	if (handle.index >= mSlots.size())
+	{
+		mSlots.resize(handle.index + 1);
+	}
+
+	ShapeSlot& slot = mSlots[handle.index];
+	if (slot.shape != nullptr)
+	{
+		ASSERT(false, "Inserting a shape into a slot that is in use");
+		return;
+	}
+
+	slot.shape = shape;
+	slot.generation = handle.generation;
+	LinkSlot(handle.index);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::AddRects(const RectParams* rects, size_t count, ShapeHandle* handles)
+{
+	AddShapes<Rect>(rects, count, nullptr, handles);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::AddLines(const LineParams* lines, size_t count, ShapeHandle* handles)
+{
+	AddShapes<Line>(lines, count, nullptr, handles);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::AddBezierCurves(const BezierCurveParams* curves, size_t count, ShapeHandle* handles)
+{
+	AddShapes<BezierCurve>(curves, count, nullptr, handles);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::AddCubicBezierCurves(const CubicBezierCurveParams* curves, size_t count, ShapeHandle* handles)
+{
+	AddShapes<CubicBezierCurve>(curves, count, nullptr, handles);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::InsertRects(const RectParams* rects, size_t count, const ShapeHandle* handles)
+{
+	AddShapes<Rect>(rects, count, handles, nullptr);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::InsertLines(const LineParams* lines, size_t count, const ShapeHandle* handles)
+{
+	AddShapes<Line>(lines, count, handles, nullptr);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::InsertBezierCurves(const BezierCurveParams* curves, size_t count, const ShapeHandle* handles)
+{
+	AddShapes<BezierCurve>(curves, count, handles, nullptr);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::InsertCubicBezierCurves(const CubicBezierCurveParams* curves, size_t count, const ShapeHandle* handles)
+{
+	AddShapes<CubicBezierCurve>(curves, count, handles, nullptr);
+}
+
+//------------------------------------------------------------------------------
+template <typename T, typename Params>
+void VectorRenderer::AddShapes(const Params* params, size_t count, const ShapeHandle* assigned, ShapeHandle* handles)
+{
+	ShapePool<T>& pool = GetPool<T>();
+	ReserveSlots(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		T* shape = ConstructShape(pool, params[i]);
+		if (assigned != nullptr)
+		{
+			InsertShape(assigned[i], shape);
+			mSlots[assigned[i].index].pool = &pool;
+			continue;
+		}
+
+		const ShapeHandle handle = AddPooledShape(shape, pool);
+		if (handles != nullptr)
+		{
+			handles[i] = handle;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+ShapeHandle VectorRenderer::AddPooledShape(const IVectorShape* shape, IShapePool& pool)
+{
+	const ShapeHandle handle = AddShape(shape);
+	mSlots[handle.index].pool = &pool;
+	return handle;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::LinkSlot(uint32_t index)
+{
+	// Append to the draw order
+	LinkSlotAfter(index, mLastSlot);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::LinkSlotAfter(uint32_t index, uint32_t previous)
+{
+	// kNoSlot puts it first
+	ShapeSlot& slot = mSlots[index];
+	slot.previous = previous;
+	slot.next = previous != kNoSlot ? mSlots[previous].next : mFirstSlot;
+	if (previous != kNoSlot)
+	{
+		mSlots[previous].next = index;
+	}
+	else
+	{
+		mFirstSlot = index;
+	}
+	if (slot.next != kNoSlot)
+	{
+		mSlots[slot.next].previous = index;
+	}
+	else
+	{
+		mLastSlot = index;
+	}
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::UpdateShape(ShapeHandle handle, const IVectorShape* shape)
+{
+	ShapeSlot* slot = GetSlot(handle);
+	if (slot == nullptr)
+	{
+		ASSERT(false, "Updating a shape through a stale handle");
+		delete shape;
+		return;
+	}
+
+	// Versions of different shapes aren't comparable, so the mesh is rebuilt in place. It keeps its palette range.
+	InvalidateGroupBounds(slot->group);
+	DestroyShape(*slot);
+	slot->shape = shape;
+	slot->mesh.valid = false;
+	slot->mesh.tessellated = false;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::RemoveShape(ShapeHandle handle)
+{
+	ShapeSlot* slot = GetSlot(handle);
+	if (slot == nullptr)
+	{
+		ASSERT(false, "Removing a shape through a stale handle");
+		return;
+	}
+
+	// Unlink from the draw order
+	if (slot->previous != kNoSlot)
+	{
+		mSlots[slot->previous].next = slot->next;
+	}
+	else
+	{
+		mFirstSlot = slot->next;
+	}
+	if (slot->next != kNoSlot)
+	{
+		mSlots[slot->next].previous = slot->previous;
+	}
+	else
+	{
+		mLastSlot = slot->previous;
+	}
+
+	if (slot->group != kNoSlot)
+	{
+		--mGroups[slot->group].shapeCount;
+		InvalidateGroupBounds(slot->group);
+		slot->group = kNoSlot;
+	}
+
+	DestroyShape(*slot);
+	slot->shape = nullptr;
+	slot->previous = kNoSlot;
+	slot->next = kNoSlot;
+	++slot->generation;
+
+	// The palette range stays with the slot for whichever shape reuses it
+	slot->mesh.data = TessellationData();
+	slot->mesh.valid = false;
+	slot->mesh.tessellated = false;
+	// Caller-assigned handles are recycled by the caller
+	if (!mExternalHandles)
+	{
+		mFreeSlots.push_back(handle.index);
+	}
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::RestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill)
+{
+	ShapeSlot* slot = GetSlot(handle);
+	if (slot == nullptr)
+	{
+		ASSERT(false, "Restyling a shape through a stale handle");
+		return;
+	}
+	if (slot->shared)
+	{
+		ASSERT(false, "Restyling a shape that belongs to a scene snapshot");
+		return;
+	}
+
+	// The renderer owns the shape. Keeping the width means neither setter invalidates it
+	IVectorShape* shape = const_cast<IVectorShape*>(slot->shape);
+	shape->SetStroke(stroke.r, stroke.g, stroke.b, stroke.a, shape->strokeWidth);
+	shape->SetFill(fill.r, fill.g, fill.b, fill.a);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::ClearShapes()
+{
+	// Only shapes that own memory are destroyed one by one, the rest go with their pool's pages
+	for (ShapeSlot& slot : mSlots)
+	{
+		if (slot.shape != nullptr && (slot.pool == nullptr || !slot.pool->IsTriviallyReleasable()))
+		{
+			DestroyShape(slot);
+		}
+		mNextGeneration = std::max(mNextGeneration, slot.generation + 1);
+	}
+	for (auto& pool : mPools)
+	{
+		pool.second->Clear();
+	}
+
+	// Dropping the slots also reclaims the palette ranges, nothing refers to them anymore
+	mSlots.clear();
+	mFreeSlots.clear();
+	mFirstSlot = kNoSlot;
+	mLastSlot = kNoSlot;
+	mStyles.clear();
+	mFreeStyleRanges.clear();
+	mScene = SceneSnapshot();
+
+	for (const Group& group : mGroups)
+	{
+		mNextGroupGeneration = std::max(mNextGroupGeneration, group.generation + 1);
+	}
+	mGroups.clear();
+	mFreeGroups.clear();
+	mGroupOrder.clear();
+	mGroupOrderDirty = false;
+}
+
+//------------------------------------------------------------------------------
+const IVectorShape* VectorRenderer::GetShape(ShapeHandle handle) const
+{
+	if (handle.index >= mSlots.size() || mSlots[handle.index].generation != handle.generation)
+	{
+		return nullptr;
+	}
+	return mSlots[handle.index].shape;
+}
+
+//------------------------------------------------------------------------------
+bool VectorRenderer::HasGroup(GroupHandle group) const
+{
+	uint32_t index = kNoSlot;
+	return FindGroup(group, index);
+}
+
+//------------------------------------------------------------------------------
+std::vector<ShapeHandle> VectorRenderer::GetShapeHandles() const
+{
+	std::vector<ShapeHandle> handles;
+	for (uint32_t i = 0; i < mSlots.size(); ++i)
+	{
+		if (mSlots[i].shape != nullptr)
+		{
+			ShapeHandle handle;
+			handle.index = i;
+			handle.generation = mSlots[i].generation;
+			handles.push_back(handle);
+		}
+	}
+	return handles;
+}
+
+//------------------------------------------------------------------------------
+std::vector<GroupHandle> VectorRenderer::GetGroupHandles() const
+{
+	std::vector<GroupHandle> handles;
+	for (uint32_t i = 0; i < mGroups.size(); ++i)
+	{
+		if (mGroups[i].live)
+		{
+			GroupHandle handle;
+			handle.index = i;
+			handle.generation = mGroups[i].generation;
+			handles.push_back(handle);
+		}
+	}
+	return handles;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::SetScene(const SceneSnapshot& scene)
+{
+	mExternalHandles = true;
+	mSceneChanges.clear();
+	SceneSnapshot::Diff(mScene, scene, mSceneChanges);
+
+	// Removals go first, an index can be reused by a new shape in the same version
+	mSceneAdded.clear();
+	for (const SceneSnapshot::Change& change : mSceneChanges)
+	{
+		ShapeHandle handle;
+		handle.index = change.index;
+		if (change.from != nullptr && change.to != nullptr && change.from->generation == change.to->generation)
+		{
+			handle.generation = change.to->generation;
+			UpdateShape(handle, change.to->shape.get());
+			mSlots[change.index].shared = true;
+			continue;
+		}
+
+		if (change.from != nullptr)
+		{
+			handle.generation = change.from->generation;
+			RemoveShape(handle);
+		}
+		if (change.to != nullptr)
+		{
+			mSceneAdded.push_back(&change);
+		}
+	}
+
+	// New shapes are normally newer than everything drawn and go last. Older ones, such as when going back to an
+	// earlier version, are put back in their place by walking back from the end.
+	std::sort(mSceneAdded.begin(), mSceneAdded.end(), [](const SceneSnapshot::Change* a, const SceneSnapshot::Change* b)
+	{
+		return a->to->order < b->to->order;
+	});
+	for (const SceneSnapshot::Change* change : mSceneAdded)
+	{
+		uint32_t previous = mLastSlot;
+		while (previous != kNoSlot)
+		{
+			const SceneSnapshot::Entry* entry = scene.FindEntry(previous);
+			if (entry == nullptr || entry->order < change->to->order)
+			{
+				break;
+			}
+			previous = mSlots[previous].previous;
+		}
+
+		if (change->index >= mSlots.size())
+		{
+			mSlots.resize(change->index + 1);
+		}
+		ShapeSlot& slot = mSlots[change->index];
+		slot.shape = change->to->shape.get();
+		slot.shared = true;
+		slot.generation = change->to->generation;
+		LinkSlotAfter(change->index, previous);
+	}
+
+	// Only now can the shapes of the previous version go
+	mScene = scene;
+}
+
+//------------------------------------------------------------------------------
+GroupHandle VectorRenderer::AddGroup(GroupHandle parent)
+{
+	ASSERT(!mExternalGroupHandles, "Adding a group to a renderer whose group handles are assigned by the caller");
+
+	uint32_t parentIndex = kNoSlot;
+	if (!FindGroup(parent, parentIndex))
+	{
+		ASSERT(false, "Adding a group to a stale parent");
+		parentIndex = kNoSlot;
+	}
+
+	uint32_t index = kNoSlot;
+	if (!mFreeGroups.empty())
+	{
+		index = mFreeGroups.back();
+		mFreeGroups.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(mGroups.size());
+		mGroups.emplace_back();
+		mGroups.back().generation = mNextGroupGeneration;
+	}
+	InitializeGroup(index, parentIndex);
+
+	GroupHandle handle;
+	handle.index = index;
+	handle.generation = mGroups[index].generation;
+	return handle;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::InsertGroup(GroupHandle handle, GroupHandle parent)
+{
+	mExternalGroupHandles = true;
+
+	uint32_t parentIndex = kNoSlot;
+	if (!FindGroup(parent, parentIndex))
+	{
+		ASSERT(false, "Adding a group to a stale parent");
+		parentIndex = kNoSlot;
+	}
+
+	if (handle.index >= mGroups.size())
+	{
+		mGroups.resize(handle.index + 1);
+	}
+	if (mGroups[handle.index].live)
+	{
+		ASSERT(false, "Inserting a group into a slot that is in use");
+		return;
+	}
+
+	mGroups[handle.index].generation = handle.generation;
+	InitializeGroup(handle.index, parentIndex);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::SetGroupTransform(GroupHandle group, const Transform& transform)
+{
+	uint32_t index = kNoSlot;
+	if (!FindGroup(group, index) || index == kNoSlot)
+	{
+		ASSERT(false, "Moving a stale group or the root group");
+		return;
+	}
+
+	mGroups[index].local = transform;
+	mGroups[index].transformDirty = true;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::RemoveGroup(GroupHandle group)
+{
+	uint32_t index = kNoSlot;
+	if (!FindGroup(group, index) || index == kNoSlot)
+	{
+		ASSERT(false, "Removing a stale group or the root group");
+		return;
+	}
+
+	Group& removed = mGroups[index];
+	if (removed.shapeCount > 0 || removed.childCount > 0)
+	{
+		ASSERT(false, "Removing a group that still has shapes or groups in it");
+		return;
+	}
+
+	if (removed.parent != kNoSlot)
+	{
+		--mGroups[removed.parent].childCount;
+		InvalidateGroupBounds(removed.parent);
+	}
+	removed.live = false;
+	++removed.generation;
+	mGroupOrderDirty = true;
+
+	// Caller-assigned handles are recycled by the caller
+	if (!mExternalGroupHandles)
+	{
+		mFreeGroups.push_back(index);
+	}
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::SetShapeGroup(ShapeHandle shape, GroupHandle group)
+{
+	ShapeSlot* slot = GetSlot(shape);
+	uint32_t index = kNoSlot;
+	if (slot == nullptr || !FindGroup(group, index))
+	{
+		ASSERT(false, "Moving a shape through a stale handle");
+		return;
+	}
+	if (slot->group == index)
+	{
+		return;
+	}
+
+	if (slot->group != kNoSlot)
+	{
+		--mGroups[slot->group].shapeCount;
+		InvalidateGroupBounds(slot->group);
+	}
+	if (index != kNoSlot)
+	{
+		++mGroups[index].shapeCount;
+		InvalidateGroupBounds(index);
+	}
+	slot->group = index;
+
+	// Tessellated in the old group's space
+	slot->mesh.valid = false;
+}
+
+//------------------------------------------------------------------------------
+bool VectorRenderer::FindGroup(GroupHandle handle, uint32_t& index) const
+{
+	// The invalid handle is the root
+	index = kNoSlot;
+	if (!handle.IsValid())
+	{
+		return true;
+	}
+	if (handle.index >= mGroups.size() || !mGroups[handle.index].live || mGroups[handle.index].generation != handle.generation)
+	{
+		return false;
+	}
+	index = handle.index;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::InitializeGroup(uint32_t index, uint32_t parent)
+{
+	Group& group = mGroups[index];
+	const uint32_t generation = group.generation;
+	group = Group();
+	group.generation = generation;
+	group.parent = parent;
+	group.live = true;
+
+	if (parent != kNoSlot)
+	{
+		group.depth = mGroups[parent].depth + 1;
+		++mGroups[parent].childCount;
+	}
+	mGroupOrderDirty = true;
+}
+
 //------------------------------------------------------------------------------
-VectorRenderer::VectorRenderer(IRenderDevice* renderer)
-	: mRenderDevice(renderer)
+void VectorRenderer::InvalidateGroupBounds(uint32_t group)
+{
+	// The root is never culled, so its bounds aren't kept
+	if (group != kNoSlot)
+	{
+		mGroups[group].contentBoundsDirty = true;
+	}
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::UpdateGroups()
 {
+	// The root is world space, seen by the camera itself
+	mRootGroup.camera = mCamera;
+	mRootGroup.visibleBounds = mCamera.GetVisibleBounds();
+	mRootGroup.pixelsPerUnit = mCamera.GetPixelsPerUnit(static_cast<float>(mRenderDevice->GetWidth()));
+	mRootGroup.viewRevision = mViewRevision;
+
+	if (mGroupOrderDirty)
+	{
+		// Sorting by depth puts every parent before its children
+		mGroupOrder.clear();
+		for (uint32_t i = 0; i < mGroups.size(); ++i)
+		{
+			if (mGroups[i].live)
+			{
+				mGroupOrder.push_back(i);
+			}
+		}
+		std::stable_sort(mGroupOrder.begin(), mGroupOrder.end(), [this](uint32_t a, uint32_t b)
+		{
+			return mGroups[a].depth < mGroups[b].depth;
+		});
+		mGroupOrderDirty = false;
+	}
+
+	// Parents first, a moved group moves everything below it
+	for (uint32_t index : mGroupOrder)
+	{
+		Group& group = mGroups[index];
+		const Group& parent = GetGroup(group.parent);
+		group.worldChanged = group.transformDirty || parent.worldChanged;
+		if (group.worldChanged)
+		{
+			group.world = Transform::Combine(parent.world, group.local);
+			group.transformDirty = false;
+		}
+
+		if (group.worldChanged || group.cameraViewRevision != mViewRevision)
+		{
+			group.camera = mCamera.GetLocalCamera(group.world);
+			group.visibleBounds = group.camera.GetVisibleBounds();
+			group.pixelsPerUnit = group.camera.GetPixelsPerUnit(static_cast<float>(mRenderDevice->GetWidth()));
+			group.cameraViewRevision = mViewRevision;
+			++group.viewRevision;
+		}
+
+		if (group.contentBoundsDirty)
+		{
+			group.contentBounds = Bounds();
+		}
+		group.subtreeBounds = Bounds();
+		group.subtreeBoundsKnown = !group.contentBoundsDirty;
+	}
+
+	// Children first, each adds its subtree to its parent's
+	for (auto it = mGroupOrder.rbegin(); it != mGroupOrder.rend(); ++it)
+	{
+		Group& group = mGroups[*it];
+		if (group.worldChanged || group.contentBoundsChanged)
+		{
+			group.worldContentBounds = group.world.Apply(group.contentBounds);
+			group.contentBoundsChanged = false;
+		}
+		group.subtreeBounds.Add(group.worldContentBounds);
+
+		if (group.parent != kNoSlot)
+		{
+			Group& parent = mGroups[group.parent];
+			parent.subtreeBounds.Add(group.subtreeBounds);
+			parent.subtreeBoundsKnown = parent.subtreeBoundsKnown && group.subtreeBoundsKnown;
+		}
+	}
+
+	// A group is out of view with its parent, or when everything in it is. Groups still gathering their bounds
+	// are drawn, and so are their parents.
+	for (uint32_t index : mGroupOrder)
+	{
+		Group& group = mGroups[index];
+		group.culled = GetGroup(group.parent).culled || (group.subtreeBoundsKnown && !group.subtreeBounds.Intersects(mRootGroup.visibleBounds));
+	}
 }
 
 //------------------------------------------------------------------------------
-void VectorRenderer::AddShape(const IVectorShape* shape)
+void VectorRenderer::FinishGroupBounds()
 {
-	mShapes.push_back(shape);
+	// Every shape of a group that was gathering its bounds has been visited by now
+	for (uint32_t index : mGroupOrder)
+	{
+		Group& group = mGroups[index];
+		if (group.contentBoundsDirty)
+		{
+			group.contentBoundsDirty = false;
+			group.contentBoundsChanged = true;
+		}
+	}
 }
 
 //------------------------------------------------------------------------------
-void VectorRenderer::ClearShapes()
+void VectorRenderer::ReserveSlots(size_t count)
 {
-	for (const IVectorShape* shape : mShapes)
+	// Grow at least geometrically, so a series of small batches doesn't reallocate every time
+	const size_t required = mSlots.size() + count - std::min(count, mFreeSlots.size());
+	if (required > mSlots.capacity())
 	{
-		delete shape;
+		mSlots.reserve(std::max(required, mSlots.capacity() * 2));
 	}
-	mShapes.clear();
+}
+
+//------------------------------------------------------------------------------
+VectorRenderer::ShapeSlot* VectorRenderer::GetSlot(ShapeHandle handle)
+{
+	if (handle.index >= mSlots.size() || mSlots[handle.index].generation != handle.generation || mSlots[handle.index].shape == nullptr)
+	{
+		return nullptr;
+	}
+	return &mSlots[handle.index];
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::DestroyShape(ShapeSlot& slot)
+{
+	if (slot.shared)
+	{
+		// Goes with the last snapshot that has it
+	}
+	else if (slot.pool != nullptr)
+	{
+		slot.pool->Destroy(slot.shape);
+	}
+	else
+	{
+		delete slot.shape;
+	}
+	slot.pool = nullptr;
+	slot.shared = false;
 }
 
 //------------------------------------------------------------------------------
 void VectorRenderer::Render()
 {
+	UpdateViewRevision();
+	UpdateGroups();
+	mRenderDevice->SetCamera(mCamera);
 	mRenderDevice->PreRender();
 
-	for (const IVectorShape* shape : mShapes)
+	// Decide what is drawn before drawing, so recolored meshes are all in the palette by the time it is
+	// uploaded. Shapes are tested in their group's space.
+	mVisibleSlots.clear();
+	mCoverageCells.clear();
+	mCoverageRuns.clear();
+	mCoverageCellIndex.clear();
+	mCoverageRunOpen = false;
+	for (uint32_t i = mFirstSlot; i != kNoSlot; i = mSlots[i].next)
+	{
+		Group& group = GetGroup(mSlots[i].group);
+		if (group.culled)
+		{
+			continue;
+		}
+
+		const IVectorShape* shape = mSlots[i].shape;
+		const Bounds& bounds = shape->GetBounds();
+		if (group.contentBoundsDirty)
+		{
+			group.contentBounds.Add(bounds);
+		}
+		if (bounds.IsEmpty() || !bounds.Intersects(group.visibleBounds))
+		{
+			continue;
+		}
+
+		// Below a pixel only the coverage of a shape is visible, not its outline
+		const double extent = std::max(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY) * group.pixelsPerUnit;
+		if (extent < kCoverageCellPixels)
+		{
+			AccumulateCoverage(i, group);
+			continue;
+		}
+
+		// A larger shape over the open run of coverage cells ends it, so the cells stay beneath the shape
+		if (mCoverageRunOpen)
+		{
+			const Bounds world = mSlots[i].group != kNoSlot ? group.world.Apply(bounds) : bounds;
+			if (world.Intersects(mCoverageRuns.back().bounds))
+			{
+				CloseCoverageRun();
+			}
+			else
+			{
+				mCoverageRuns.back().laterBounds.Add(world);
+			}
+		}
+
+		// Shapes with a fast path the device has go through it unless it failed last time. The rest are drawn
+		// from their meshes, and stale ones are rebuilt together before drawing.
+		RetainedMesh& mesh = mSlots[i].mesh;
+		mesh.direct = shape->HasDirectPath(mRenderDevice) && !mesh.tessellated;
+		if (!mesh.direct && !IsTessellationUpToDate(i))
+		{
+			mRebuildSlots.push_back(i);
+		}
+		else if ((mesh.direct && AllocateStyles(i)) || mesh.styleVersion != shape->GetStyleVersion())
+		{
+			// Shapes on a fast path have their colors in the palette too, so one that fails and falls back to its
+			// mesh while drawing doesn't upload the palette again
+			WriteStyles(i);
+		}
+		mVisibleSlots.push_back(i);
+	}
+	FinishGroupBounds();
+	RebuildTessellations();
+
+	BuildBatches();
+	SortBatches();
+	DrawBatches();
+
+	mRenderDevice->Render();
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::BuildBatches()
+{
+	// A pixel of margin, antialiased edges reach slightly past the bounds
+	const double margin = 1.0 / mRootGroup.pixelsPerUnit;
+
+	// Cells of the layer grid, the view split evenly along each side
+	const Bounds& view = mRootGroup.visibleBounds;
+	const double scaleX = view.maxX > view.minX ? kLayerGridCells / (view.maxX - view.minX) : 0.0;
+	const double scaleY = view.maxY > view.minY ? kLayerGridCells / (view.maxY - view.minY) : 0.0;
+	auto cell = [](double position, double origin, double scale)
+	{
+		return static_cast<uint32_t>(std::min(std::max((position - origin) * scale, 0.0), kLayerGridCells - 1.0));
+	};
+
+	mBatches.clear();
+	mVisibleBounds.resize(mVisibleSlots.size());
+	mVisibleCells.resize(mVisibleSlots.size());
+	mVisibleBatches.resize(mVisibleSlots.size());
+	for (size_t v = 0; v < mVisibleSlots.size(); ++v)
+	{
+		// Runs of coverage cells are drawn through the device fast path in the root group
+		const uint32_t entry = mVisibleSlots[v];
+		const bool coverage = (entry & kCoverageRunEntry) != 0;
+		const uint32_t group = coverage ? kNoSlot : mSlots[entry].group;
+		const bool direct = coverage || mSlots[entry].mesh.direct;
+		const PrimitiveTopology topology = coverage ? PrimitiveTopology::TriangleList : mSlots[entry].mesh.data.topology;
+
+		Bounds& bounds = mVisibleBounds[v];
+		if (coverage)
+		{
+			bounds = mCoverageRuns[entry & ~kCoverageRunEntry].bounds;
+		}
+		else
+		{
+			const IVectorShape* shape = mSlots[entry].shape;
+			bounds = group != kNoSlot ? GetGroup(group).world.Apply(shape->GetBounds()) : shape->GetBounds();
+			bounds.Inflate(margin);
+		}
+		mVisibleCells[v] = cell(bounds.minX, view.minX, scaleX) | cell(bounds.maxX, view.minX, scaleX) << 8 | cell(bounds.minY, view.minY, scaleY) << 16 | cell(bounds.maxY, view.minY, scaleY) << 24;
+
+		// Latest batch with the same state that nothing drawn after it overlaps. A shape that finds none within
+		// reach starts a new batch.
+		size_t target = mBatches.size();
+		const size_t oldest = mBatches.size() - std::min(mBatches.size(), kMaxBatchLookback);
+		for (size_t b = mBatches.size(); b > oldest; --b)
+		{
+			const DrawBatch& batch = mBatches[b - 1];
+			if (batch.group == group && batch.direct == direct && (batch.direct || batch.topology == topology))
+			{
+				target = b - 1;
+				break;
+			}
+			if (batch.bounds.Intersects(bounds))
+			{
+				break;
+			}
+		}
+
+		if (target == mBatches.size())
+		{
+			mBatches.emplace_back();
+			mBatches.back().group = group;
+			mBatches.back().direct = direct;
+			mBatches.back().topology = topology;
+		}
+		mBatches[target].bounds.Add(bounds);
+		++mBatches[target].count;
+		mVisibleBatches[v] = static_cast<uint32_t>(target);
+	}
+
+	// Counting sort by batch, stable so each batch keeps its shapes in the order they were added
+	uint32_t first = 0;
+	for (DrawBatch& batch : mBatches)
+	{
+		batch.first = first;
+		first += batch.count;
+		batch.count = 0;
+	}
+	mBatchedEntries.resize(mVisibleSlots.size());
+	for (size_t v = 0; v < mVisibleSlots.size(); ++v)
+	{
+		DrawBatch& batch = mBatches[mVisibleBatches[v]];
+		mBatchedEntries[batch.first + batch.count++] = static_cast<uint32_t>(v);
+	}
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::SortBatches()
+{
+	mDrawKeys.clear();
+	mDrawKeys.reserve(mBatches.size());
+
+	// Past what the keys can number, the batches are drawn as they were built
+	if (mBatches.size() > kDrawKeySequenceMask)
+	{
+		for (size_t b = 0; b < mBatches.size(); ++b)
+		{
+			mDrawKeys.push_back(b);
+		}
+		return;
+	}
+
+	// A batch goes on the layer above every cell its shapes touch. Shapes of earlier batches that overlap them
+	// touch a shared cell, so overlapping batches keep their order while the rest are free to move.
+	auto visitCells = [&](const DrawBatch& batch, const auto& visit)
+	{
+		for (uint32_t e = batch.first; e < batch.first + batch.count; ++e)
+		{
+			const uint32_t cells = mVisibleCells[mBatchedEntries[e]];
+			for (uint32_t row = (cells >> 16) & 0xFF; row <= cells >> 24; ++row)
+			{
+				for (uint32_t column = cells & 0xFF; column <= ((cells >> 8) & 0xFF); ++column)
+				{
+					visit(mLayerCells[row * kLayerGridCells + column]);
+				}
+			}
+		}
+	};
+
+	// Cells hold one past the highest layer in them, so zero is a cell nothing has touched
+	mLayerCells.assign(kLayerGridCells * kLayerGridCells, 0);
+	for (size_t b = 0; b < mBatches.size(); ++b)
+	{
+		DrawBatch& batch = mBatches[b];
+		uint32_t layer = 0;
+		visitCells(batch, [&layer](uint32_t& cell) { layer = std::max(layer, cell); });
+		visitCells(batch, [layer](uint32_t& cell) { cell = std::max(cell, layer + 1); });
+		batch.layer = layer;
+
+		// Every other layer runs through the states backwards, so a layer starts with the state the last one
+		// ended on
+		const uint64_t pipeline = batch.direct ? 0 : 1 + static_cast<uint64_t>(batch.topology == PrimitiveTopology::TriangleStrip);
+		const uint64_t resource = batch.group == kNoSlot ? 0 : (batch.group + uint64_t(1)) & ((uint64_t(1) << kDrawKeyResourceBits) - 1);
+		uint64_t state = (pipeline << kDrawKeyResourceBits) | resource;
+		if (batch.layer & 1)
+		{
+			state = ~state & ((uint64_t(1) << kDrawKeyStateBits) - 1);
+		}
+		mDrawKeys.push_back((uint64_t(batch.layer) << (kDrawKeyStateBits + kDrawKeySequenceBits)) | (state << kDrawKeySequenceBits) | b);
+	}
+
+	RadixSort(mDrawKeys, mDrawKeyScratch, &mThreadPool);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::DrawBatches()
+{
+	uint32_t deviceGroup = kNoSlot;
+	for (uint64_t key : mDrawKeys)
+	{
+		const DrawBatch& batch = mBatches[key & kDrawKeySequenceMask];
+
+		// Meshes of consecutive batches with the same state go out as one draw
+		if (!mBatchMeshes.empty() && (batch.direct || batch.group != deviceGroup || batch.topology != mBatchTopology))
+		{
+			DrawBatchData();
+		}
+
+		// The device sees a group's space through the group's camera
+		if (batch.group != deviceGroup)
+		{
+			mRenderDevice->SetCamera(GetGroup(batch.group).camera);
+			deviceGroup = batch.group;
+		}
+		const uint32_t viewRevision = GetGroup(batch.group).viewRevision;
+
+		for (uint32_t e = batch.first; e < batch.first + batch.count; ++e)
+		{
+			const uint32_t v = mBatchedEntries[e];
+			const uint32_t i = mVisibleSlots[v];
+			if (i & kCoverageRunEntry)
+			{
+				DrawCoverageRun(i & ~kCoverageRunEntry);
+				continue;
+			}
+
+			ShapeSlot& slot = mSlots[i];
+			if (batch.direct)
+			{
+				if (slot.shape->DrawDirect(mRenderDevice))
+				{
+					slot.mesh.tessellated = false;
+					continue;
+				}
+
+				slot.mesh.directViewRevision = viewRevision;
+				DrawTessellation(GetTessellation(i));
+				continue;
+			}
+
+			// A fast path that failed is tried again once the view changes, as long as drawing the shape ahead of
+			// the geometry still waiting in the batch can't change what ends up on top
+			if (slot.shape->HasDirectPath(mRenderDevice) && slot.mesh.directViewRevision != viewRevision && !mBatchDataBounds.Intersects(mVisibleBounds[v]))
+			{
+				if (slot.shape->DrawDirect(mRenderDevice))
+				{
+					slot.mesh.tessellated = false;
+					continue;
+				}
+				slot.mesh.directViewRevision = viewRevision;
+			}
+
+			AppendToBatch(GetTessellation(i));
+			mBatchDataBounds.Add(mVisibleBounds[v]);
+		}
+	}
+	DrawBatchData();
+
+	if (deviceGroup != kNoSlot)
+	{
+		mRenderDevice->SetCamera(mCamera);
+	}
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::AppendToBatch(const TessellationData& data)
+{
+	if (data.indices.empty())
+	{
+		return;
+	}
+
+	// Drawn early rather than overflowing the 16-bit indices
+	if (mBatchVertexCount + data.vertices.size() > kMaxBatchVertices)
+	{
+		DrawBatchData();
+	}
+
+	// Strips of different meshes are kept apart by a restart
+	if (data.topology == PrimitiveTopology::TriangleStrip && !mBatchMeshes.empty())
+	{
+		++mBatchIndexCount;
+	}
+	mBatchMeshes.push_back(&data);
+	mBatchVertexCount += data.vertices.size();
+	mBatchIndexCount += data.indices.size();
+	mBatchTopology = data.topology;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::DrawBatchData()
+{
+	if (mBatchMeshes.empty())
+	{
+		return;
+	}
+
+	if (mStylesDirty)
+	{
+		mRenderDevice->SetStyles(mStyles.data(), mStyles.size());
+		mStylesDirty = false;
+	}
+
+	// The retained meshes are copied once, into the device's buffers. A restart isn't offset like the other indices.
+	Vertex* vertices = mRenderDevice->MapVertexBuffer(mBatchVertexCount * sizeof(Vertex));
+	uint16_t* indices = mRenderDevice->MapIndexBuffer(mBatchIndexCount * sizeof(uint16_t));
+	if (vertices != nullptr && indices != nullptr)
+	{
+		uint16_t baseVertex = 0;
+		for (const TessellationData* data : mBatchMeshes)
+		{
+			if (data->topology == PrimitiveTopology::TriangleStrip && data != mBatchMeshes.front())
+			{
+				*indices++ = kStripRestartIndex;
+			}
+			for (uint16_t index : data->indices)
+			{
+				*indices++ = index == kStripRestartIndex ? kStripRestartIndex : static_cast<uint16_t>(index + baseVertex);
+			}
+			std::copy(data->vertices.begin(), data->vertices.end(), vertices);
+			vertices += data->vertices.size();
+			baseVertex = static_cast<uint16_t>(baseVertex + data->vertices.size());
+		}
+	}
+	mRenderDevice->UnmapBuffers();
+
+	if (vertices != nullptr && indices != nullptr)
 	{
-		const TessellationData data = shape->Tessellate(mRenderDevice);
-	
-		mRenderDevice->CreateVertexBuffer(data.vertices.data(), data.vertices.size() * sizeof(Vertex));
-		mRenderDevice->CreateIndexBuffer(data.indices.data(), data.indices.size() * sizeof(uint16_t));
 		mRenderDevice->SetVertexBuffer();
 		mRenderDevice->SetIndexBuffer();
 		mRenderDevice->SetConstantBuffers();
-	
-		mRenderDevice->DrawIndexedTriangles(data.indices.size());
+		mRenderDevice->DrawIndexedTriangles(mBatchIndexCount, mBatchTopology);
 	}
 
-	mRenderDevice->Render();
-}
\ No newline at end of file
+	mBatchMeshes.clear();
+	mBatchVertexCount = 0;
+	mBatchIndexCount = 0;
+	mBatchDataBounds = Bounds();
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::DrawTessellation(const TessellationData& data)
+{
+	if (data.indices.empty())
+	{
+		return;
+	}
+
+	if (mStylesDirty)
+	{
+		mRenderDevice->SetStyles(mStyles.data(), mStyles.size());
+		mStylesDirty = false;
+	}
+
+	mRenderDevice->CreateVertexBuffer(data.vertices.data(), data.vertices.size() * sizeof(Vertex));
+	mRenderDevice->CreateIndexBuffer(data.indices.data(), data.indices.size() * sizeof(uint16_t));
+	mRenderDevice->SetVertexBuffer();
+	mRenderDevice->SetIndexBuffer();
+	mRenderDevice->SetConstantBuffers();
+
+	mRenderDevice->DrawIndexedTriangles(data.indices.size(), data.topology);
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::AccumulateCoverage(uint32_t slot, const Group& group)
+{
+	const IVectorShape& shape = *mSlots[slot].shape;
+	const Bounds& bounds = shape.GetBounds();
+	const float viewportWidth = static_cast<float>(mRenderDevice->GetWidth());
+	const float viewportHeight = static_cast<float>(mRenderDevice->GetHeight());
+
+	float screenX = 0.0f;
+	float screenY = 0.0f;
+	group.camera.WorldToScreen((bounds.minX + bounds.maxX) * 0.5, (bounds.minY + bounds.maxY) * 0.5, viewportWidth, viewportHeight, screenX, screenY);
+	const int32_t column = static_cast<int32_t>(std::floor(screenX));
+	const int32_t row = static_cast<int32_t>(std::floor(screenY));
+	if (column < 0 || row < 0 || column >= mRenderDevice->GetWidth() || row >= mRenderDevice->GetHeight())
+	{
+		return;
+	}
+
+	const Style color = shape.GetCoverage(group.pixelsPerUnit);
+	if (!(color.a > 0.0f))
+	{
+		return;
+	}
+
+	// A shape under a larger one listed after the open run started goes into a new run drawn after that shape
+	Bounds world = mSlots[slot].group != kNoSlot ? group.world.Apply(bounds) : bounds;
+	world.Inflate(1.0 / mRootGroup.pixelsPerUnit);
+	if (mCoverageRunOpen && world.Intersects(mCoverageRuns.back().laterBounds))
+	{
+		CloseCoverageRun();
+	}
+	if (!mCoverageRunOpen)
+	{
+		mVisibleSlots.push_back(kCoverageRunEntry | static_cast<uint32_t>(mCoverageRuns.size()));
+		mCoverageRuns.emplace_back();
+		mCoverageRuns.back().firstCell = mCoverageCells.size();
+		mCoverageRunOpen = true;
+	}
+	mCoverageRuns.back().bounds.Add(world);
+
+	const int64_t key = static_cast<int64_t>(row) * mRenderDevice->GetWidth() + column;
+	auto it = mCoverageCellIndex.find(key);
+	if (it == mCoverageCellIndex.end())
+	{
+		it = mCoverageCellIndex.emplace(key, mCoverageCells.size()).first;
+		mCoverageCells.emplace_back();
+		mCoverageCells.back().column = column;
+		mCoverageCells.back().row = row;
+	}
+
+	// Color is the coverage-weighted average, alpha composites like overlapping translucent layers
+	CoverageCell& cell = mCoverageCells[it->second];
+	cell.r += color.r * color.a;
+	cell.g += color.g * color.a;
+	cell.b += color.b * color.a;
+	cell.weight += color.a;
+	cell.transparency *= 1.0f - color.a;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::CloseCoverageRun()
+{
+	// Only the open run's cells are in the index, which is cheaper to empty cell by cell than to clear
+	for (size_t c = mCoverageRuns.back().firstCell; c < mCoverageCells.size(); ++c)
+	{
+		mCoverageCellIndex.erase(static_cast<int64_t>(mCoverageCells[c].row) * mRenderDevice->GetWidth() + mCoverageCells[c].column);
+	}
+	mCoverageRunOpen = false;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::DrawCoverageRun(uint32_t run)
+{
+	const size_t firstCell = mCoverageRuns[run].firstCell;
+	const size_t lastCell = run + 1 < mCoverageRuns.size() ? mCoverageRuns[run + 1].firstCell : mCoverageCells.size();
+	const double pixelsPerUnit = mRootGroup.pixelsPerUnit;
+	const float viewportWidth = static_cast<float>(mRenderDevice->GetWidth());
+	const float viewportHeight = static_cast<float>(mRenderDevice->GetHeight());
+
+	// The cost is bounded by the pixel count rather than the number of sub-pixel shapes
+	mCamera.GetOrigin(mCoverageMarkers.originX, mCoverageMarkers.originY);
+	mCoverageMarkers.markers.clear();
+	mCoverageMarkers.markers.reserve(lastCell - firstCell);
+	for (size_t c = firstCell; c < lastCell; ++c)
+	{
+		const CoverageCell& cell = mCoverageCells[c];
+		if (1.0f - cell.transparency < kMinCoverage)
+		{
+			continue;
+		}
+
+		double x = 0.0;
+		double y = 0.0;
+		mCamera.ScreenToWorld(cell.column + 0.5f, cell.row + 0.5f, viewportWidth, viewportHeight, x, y);
+		mCoverageMarkers.AddMarker(x, y, static_cast<float>(1.0 / pixelsPerUnit), cell.r / cell.weight, cell.g / cell.weight, cell.b / cell.weight, 1.0f - cell.transparency);
+	}
+
+	if (!mCoverageMarkers.DrawDirect(mRenderDevice))
+	{
+		// Styles go after the retained ranges for this draw only
+		const size_t styleBase = mStyles.size();
+		mStyles.resize(styleBase + mCoverageMarkers.GetStyleCount());
+		mCoverageMarkers.GetStyles(mStyles.data() + styleBase);
+		mStylesDirty = true;
+
+		TessellationData data;
+		TessellationDataSink sink(data, static_cast<uint32_t>(styleBase));
+		mCoverageMarkers.Tessellate(mRenderDevice, sink);
+
+		DrawTessellation(data);
+		mStyles.resize(styleBase);
+	}
+}
+
+//------------------------------------------------------------------------------
+const TessellationData& VectorRenderer::GetTessellation(uint32_t slot)
+{
+	if (!IsTessellationUpToDate(slot))
+	{
+		// The colors are usually in the palette already, see Render
+		const bool allocated = AllocateStyles(slot);
+		BuildTessellation(slot, 0);
+		if (allocated || mSlots[slot].mesh.styleVersion != mSlots[slot].shape->GetStyleVersion())
+		{
+			WriteStyles(slot);
+		}
+	}
+
+	mSlots[slot].mesh.tessellated = true;
+	return mSlots[slot].mesh.data;
+}
+
+//------------------------------------------------------------------------------
+bool VectorRenderer::IsTessellationUpToDate(uint32_t slot) const
+{
+	const IVectorShape* shape = mSlots[slot].shape;
+	const RetainedMesh& mesh = mSlots[slot].mesh;
+	const Group& group = GetGroup(mSlots[slot].group);
+
+	// Vertices are relative to the render origin, so a rebase invalidates every mesh. Moving a group only
+	// rebases its meshes once the view from it has moved as far as a pan that would.
+	double originX = 0.0;
+	double originY = 0.0;
+	group.camera.GetOrigin(originX, originY);
+
+	return mesh.valid
+		&& mesh.shapeVersion == shape->GetVersion()
+		&& (!shape->IsZoomDependent() || mesh.zoomLevel == group.camera.GetZoomLevel())
+		&& mesh.originX == originX
+		&& mesh.originY == originY
+		&& (!shape->IsViewDependent() || mesh.viewRevision == group.viewRevision);
+}
+
+//------------------------------------------------------------------------------
+bool VectorRenderer::AllocateStyles(uint32_t slot)
+{
+	// Returns whether the range changed, and with it what the palette holds for the shape
+	RetainedMesh& mesh = mSlots[slot].mesh;
+	const uint32_t styleCount = mSlots[slot].shape->GetStyleCount();
+	mesh.styleCount = styleCount;
+	if (styleCount <= mesh.styleCapacity)
+	{
+		return false;
+	}
+
+	// The range at the end of the palette grows in place, so a shape that keeps growing stays there
+	if (mesh.styleCapacity > 0 && mesh.styleBase + mesh.styleCapacity == mStyles.size())
+	{
+		mesh.styleCapacity = styleCount;
+		mStyles.resize(mesh.styleBase + styleCount);
+		return true;
+	}
+
+	// Anywhere else the outgrown range is given up, and the first free one large enough is taken instead
+	if (mesh.styleCapacity > 0)
+	{
+		StyleRange outgrown;
+		outgrown.base = mesh.styleBase;
+		outgrown.capacity = mesh.styleCapacity;
+		mFreeStyleRanges.push_back(outgrown);
+	}
+	for (size_t i = 0; i < mFreeStyleRanges.size(); ++i)
+	{
+		if (mFreeStyleRanges[i].capacity >= styleCount)
+		{
+			mesh.styleBase = mFreeStyleRanges[i].base;
+			mesh.styleCapacity = mFreeStyleRanges[i].capacity;
+			mFreeStyleRanges[i] = mFreeStyleRanges.back();
+			mFreeStyleRanges.pop_back();
+			return true;
+		}
+	}
+
+	mesh.styleBase = static_cast<uint32_t>(mStyles.size());
+	mesh.styleCapacity = styleCount;
+	mStyles.resize(mStyles.size() + styleCount);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::BuildTessellation(uint32_t slot, size_t vertexCount)
+{
+	// Only touches the slot's own mesh, so slots can be built in parallel once their styles are allocated. The
+	// device's camera is the view from the slot's group.
+	const IVectorShape* shape = mSlots[slot].shape;
+	const Group& group = GetGroup(mSlots[slot].group);
+	RetainedMesh& mesh = mSlots[slot].mesh;
+	mesh.data.vertices.reserve(vertexCount);
+
+	// The sink writes the vertices with their final style indices, in the shape's range of the palette
+	TessellationDataSink sink(mesh.data, mesh.styleBase);
+	shape->Tessellate(mRenderDevice, sink);
+	mesh.data.Optimize();
+
+	mesh.shapeVersion = shape->GetVersion();
+	mesh.viewRevision = group.viewRevision;
+	mesh.zoomLevel = group.camera.GetZoomLevel();
+	group.camera.GetOrigin(mesh.originX, mesh.originY);
+	mesh.valid = true;
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::RebuildTessellations()
+{
+	if (mRebuildSlots.empty())
+	{
+		return;
+	}
+
+	// Shapes tessellate in their group's space, so each group's run is built with the view from that group
+	const auto byGroup = [this](uint32_t a, uint32_t b)
+	{
+		return mSlots[a].group < mSlots[b].group;
+	};
+	if (!std::is_sorted(mRebuildSlots.begin(), mRebuildSlots.end(), byGroup))
+	{
+		std::stable_sort(mRebuildSlots.begin(), mRebuildSlots.end(), byGroup);
+	}
+
+	mRebuildVertexCounts.resize(mRebuildSlots.size());
+	mRebuildOffsets.resize(mRebuildSlots.size() + 1);
+	size_t first = 0;
+	while (first < mRebuildSlots.size())
+	{
+		const uint32_t group = mSlots[mRebuildSlots[first]].group;
+		size_t last = first + 1;
+		while (last < mRebuildSlots.size() && mSlots[mRebuildSlots[last]].group == group)
+		{
+			++last;
+		}
+
+		mRenderDevice->SetCamera(GetGroup(group).camera);
+		RebuildTessellationRange(first, last);
+		first = last;
+	}
+	mRenderDevice->SetCamera(mCamera);
+
+	for (uint32_t slot : mRebuildSlots)
+	{
+		WriteStyles(slot);
+	}
+	mRebuildSlots.clear();
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::RebuildTessellationRange(size_t first, size_t last)
+{
+	// Running total of the estimated vertices, so every thread gets about the same amount of work
+	mRebuildOffsets[first] = 0;
+	for (size_t i = first; i < last; ++i)
+	{
+		const uint32_t slot = mRebuildSlots[i];
+		AllocateStyles(slot);
+
+		size_t indexCount = 0;
+		mSlots[slot].shape->GetTessellationSize(mRenderDevice, mRebuildVertexCounts[i], indexCount);
+		mRebuildOffsets[i + 1] = mRebuildOffsets[i] + mRebuildVertexCounts[i] + kRebuildShapeCost;
+	}
+
+	const size_t totalCost = mRebuildOffsets[last];
+	const size_t threadCount = std::min(mThreadPool.GetThreadCount(), totalCost / kMinRebuildCostPerThread + 1);
+
+	// Split where the running total crosses each thread's share
+	mRebuildSplits.resize(threadCount + 1);
+	mRebuildSplits[0] = first;
+	mRebuildSplits[threadCount] = last;
+	for (size_t t = 1; t < threadCount; ++t)
+	{
+		const size_t share = totalCost * t / threadCount;
+		mRebuildSplits[t] = std::lower_bound(mRebuildOffsets.begin() + mRebuildSplits[t - 1], mRebuildOffsets.begin() + last, share) - mRebuildOffsets.begin();
+	}
+
+	mThreadPool.Run(threadCount, [this](size_t part)
+	{
+		for (size_t i = mRebuildSplits[part]; i < mRebuildSplits[part + 1]; ++i)
+		{
+			BuildTessellation(mRebuildSlots[i], mRebuildVertexCounts[i]);
+		}
+	});
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::WriteStyles(uint32_t slot)
+{
+	RetainedMesh& mesh = mSlots[slot].mesh;
+	mesh.styleVersion = mSlots[slot].shape->GetStyleVersion();
+	if (mesh.styleCount > 0)
+	{
+		mSlots[slot].shape->GetStyles(mStyles.data() + mesh.styleBase);
+		mStylesDirty = true;
+	}
+}
+
+//------------------------------------------------------------------------------
+void VectorRenderer::UpdateViewRevision()
+{
+	const int32_t width = mRenderDevice->GetWidth();
+	const int32_t height = mRenderDevice->GetHeight();
+	if (mCamera != mLastCamera || width != mLastWidth || height != mLastHeight)
+	{
+		mLastCamera = mCamera;
+		mLastWidth = width;
+		mLastHeight = height;
+		++mViewRevision;
+	}
+}
@@ -1,24 +1,373 @@
 #pragma once
 
+#include "Camera.h"
+#include "Scene.h"
+#include "ShapeHandle.h"
+
+// Utils
+#include <Utils/ThreadPool.h>
+#include <Utils/Transform.h>
+
+// Vector
+#include <Vector/ShapePool.h>
+#include <Vector/VectorShape.h>
+
 // System
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
 #include <vector>
 
 //------------------------------------------------------------------------------
 class IRenderDevice;
-class IVectorShape;
 
 //------------------------------------------------------------------------------
 class VectorRenderer
 {
 public:
+	// Packed parameters for bulk submission, one element per shape
+	struct RectParams
+	{
+		double x, y, width, height;
+		Style fill;
+	};
+
+	struct LineParams
+	{
+		double x1, y1, x2, y2;
+		Style stroke;
+		float strokeWidth;
+	};
+
+	struct BezierCurveParams
+	{
+		double x1, y1, x2, y2, cx1, cy1;
+		Style stroke;
+		float strokeWidth;
+	};
+
+	struct CubicBezierCurveParams
+	{
+		double x1, y1, x2, y2, cx1, cy1, cx2, cy2;
+		Style stroke;
+		float strokeWidth;
+	};
+
 	VectorRenderer(IRenderDevice* renderer);
+	~VectorRenderer();
 
-	void AddShape(const IVectorShape* shape);
+	// The renderer owns the shapes. Shapes draw in the order they were added, an updated shape keeps its place.
+	ShapeHandle AddShape(const IVectorShape* shape);
+
+	// Constructs the shape in the scene's pool for its type and adds it. Cheaper than new + AddShape for large
+	// scenes, and clearing the scene releases pooled shapes a page at a time.
+	template <typename T, typename... Args>
+	ShapeHandle CreateShape(T*& shape, Args&&... args)
+	{
+		ShapePool<T>& pool = GetPool<T>();
+		shape = pool.Create(std::forward<Args>(args)...);
+		return AddPooledShape(shape, pool);
+	}
+
+	// Bulk versions of CreateShape for ingesting large documents. Every element still becomes its own pooled shape
+	// and slot with its own handle, what is saved is the heap allocation per shape, the virtual setters and growing
+	// the slot table one shape at a time. Handles are written to the optional array, in order.
+	void AddRects(const RectParams* rects, size_t count, ShapeHandle* handles = nullptr);
+	void AddLines(const LineParams* lines, size_t count, ShapeHandle* handles = nullptr);
+	void AddBezierCurves(const BezierCurveParams* curves, size_t count, ShapeHandle* handles = nullptr);
+	void AddCubicBezierCurves(const CubicBezierCurveParams* curves, size_t count, ShapeHandle* handles = nullptr);
+
+	// Versions of the above for handles assigned by the caller with a ShapeHandleAllocator, such as when the
+	// renderer runs on another thread. A renderer takes either kind of handle, not both.
+	void InsertShape(ShapeHandle handle, const IVectorShape* shape);
+	void InsertRects(const RectParams* rects, size_t count, const ShapeHandle* handles);
+	void InsertLines(const LineParams* lines, size_t count, const ShapeHandle* handles);
+	void InsertBezierCurves(const BezierCurveParams* curves, size_t count, const ShapeHandle* handles);
+	void InsertCubicBezierCurves(const CubicBezierCurveParams* curves, size_t count, const ShapeHandle* handles);
+
+	void UpdateShape(ShapeHandle handle, const IVectorShape* shape);
+	void RemoveShape(ShapeHandle handle);
+
+	// Changes the stroke and fill colors. Only the palette is rewritten, the tessellation is kept.
+	void RestyleShape(ShapeHandle handle, const Style& stroke, const Style& fill);
+
+	// Removes every shape and group
 	void ClearShapes();
+
+	// Groups place their shapes and child groups with a transform. Moving a group only changes the matrix the
+	// device draws its shapes with, they keep their tessellation, and a group whose contents are all out of view
+	// is skipped as a whole. Shapes start out in the root group, which is world space and has the invalid handle.
+	GroupHandle AddGroup(GroupHandle parent = GroupHandle());
+	void InsertGroup(GroupHandle handle, GroupHandle parent);
+	void SetGroupTransform(GroupHandle group, const Transform& transform);
+
+	// Only empty groups can be removed, their shapes and groups have to be removed first
+	void RemoveGroup(GroupHandle group);
+
+	// The shape's coordinates are in the group's space from then on
+	void SetShapeGroup(ShapeHandle shape, GroupHandle group);
+
+	// Null if the handle is stale
+	const IVectorShape* GetShape(ShapeHandle handle) const;
+	bool HasGroup(GroupHandle group) const;
+
+	// Handles of every shape and group the renderer has
+	std::vector<ShapeHandle> GetShapeHandles() const;
+	std::vector<GroupHandle> GetGroupHandles() const;
+
+	// Shows a version of a Scene, whose handles then refer to the renderer's shapes as well. Only what changed
+	// since the last version shown is applied, everything else keeps its tessellation. The shapes stay with the
+	// snapshot, a renderer shows either scene snapshots or its own shapes, not both.
+	void SetScene(const SceneSnapshot& scene);
+
 	void Render();
 
+	// Navigating only changes the view-projection constant, tessellations are kept relative to the camera's
+	// render origin and only rebuilt when that origin moves
+	Camera& GetCamera() { return mCamera; }
+	const Camera& GetCamera() const { return mCamera; }
+
 private:
+	// Tessellation kept across frames until the shape (or for view-dependent shapes, the view) changes
+	struct RetainedMesh
+	{
+		TessellationData data;
+		uint32_t shapeVersion = 0;
+		uint32_t viewRevision = 0;
+		int32_t zoomLevel = 0;
+		double originX = 0.0;
+		double originY = 0.0;
+		bool valid = false;
+
+		// Drawn from this mesh last time rather than through a device fast path
+		bool tessellated = false;
+
+		// Going through the device fast path this frame, and the view from the group it last failed for
+		bool direct = false;
+		uint32_t directViewRevision = 0;
+
+		// Range of the style palette the vertices refer to, and the shape's style version written into it
+		uint32_t styleBase = 0;
+		uint32_t styleCount = 0;
+		uint32_t styleCapacity = 0;
+		uint32_t styleVersion = 0;
+	};
+
+	// Palette range given up by a mesh that outgrew it, reused by the next one it is large enough for
+	struct StyleRange
+	{
+		uint32_t base = 0;
+		uint32_t capacity = 0;
+	};
+
+	// Pixel that sub-pixel shapes are collapsed into, drawn as a single marker with their combined coverage
+	struct CoverageCell
+	{
+		int32_t column = 0;
+		int32_t row = 0;
+		float r = 0.0f;
+		float g = 0.0f;
+		float b = 0.0f;
+		float weight = 0.0f;
+		float transparency = 1.0f;
+	};
+
+	// Cells of sub-pixel shapes drawn where the first of them is, which holds as long as no larger shape listed
+	// in between overlaps them. The bounds are in world space and include the pixel the cells snap to.
+	struct CoverageRun
+	{
+		size_t firstCell = 0;
+		Bounds bounds;
+		Bounds laterBounds; // Larger shapes listed after the run started
+	};
+
+	static const uint32_t kNoSlot = UINT32_MAX;
+
+	// Visible entry that is a run of coverage cells rather than a slot, the rest of the bits are the run's index
+	static const uint32_t kCoverageRunEntry = 0x80000000u;
+
+	// Run of draws with the same device state. Shapes join the latest batch with their state unless a batch
+	// after it overlaps them, so painter's order only holds where shapes actually overlap. Batches on the same
+	// layer don't overlap each other and may be drawn in any order.
+	struct DrawBatch
+	{
+		uint32_t group = kNoSlot;
+		bool direct = false;
+		PrimitiveTopology topology = PrimitiveTopology::TriangleList;
+		Bounds bounds;
+		uint32_t layer = 0;
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	// Storage for one shape, reused through the free list. Live slots form a linked list in draw order so
+	// removing from the middle doesn't move anything.
+	struct ShapeSlot
+	{
+		const IVectorShape* shape = nullptr;
+		IShapePool* pool = nullptr; // Null for shapes allocated with new
+		bool shared = false; // Owned by the scene snapshot rather than the renderer
+		uint32_t group = kNoSlot; // kNoSlot for the root group
+		uint32_t generation = 0;
+		uint32_t previous = kNoSlot;
+		uint32_t next = kNoSlot;
+		RetainedMesh mesh;
+	};
+
+	// Node of the transform hierarchy. The world transform and the view from the group are cached, and only
+	// recomputed when the group or one of its parents moves or the camera changes.
+	struct Group
+	{
+		Transform local;
+		Transform world;
+
+		// The camera as seen from the group's space, with the visible box and scale in that space
+		Camera camera;
+		Bounds visibleBounds;
+		double pixelsPerUnit = 0.0;
+		uint32_t viewRevision = 0;
+		uint32_t cameraViewRevision = 0;
+
+		uint32_t parent = kNoSlot; // kNoSlot for children of the root
+		uint32_t depth = 0;
+		uint32_t generation = 0;
+		uint32_t shapeCount = 0;
+		uint32_t childCount = 0;
+		bool live = false;
+		bool transformDirty = true;
+		bool worldChanged = false;
+
+		// Box around the group's own shapes in its space, gathered while drawing after it may have changed
+		Bounds contentBounds;
+		Bounds worldContentBounds;
+		bool contentBoundsDirty = false;
+		bool contentBoundsChanged = false;
+
+		// World box around everything in the subtree, unknown while any of it is being gathered
+		Bounds subtreeBounds;
+		bool subtreeBoundsKnown = false;
+		bool culled = false;
+	};
+
+	template <typename T>
+	ShapePool<T>& GetPool()
+	{
+		std::unique_ptr<IShapePool>& pool = mPools[std::type_index(typeid(T))];
+		if (pool == nullptr)
+		{
+			pool.reset(new ShapePool<T>());
+		}
+		return static_cast<ShapePool<T>&>(*pool);
+	}
+
+	ShapeHandle AddPooledShape(const IVectorShape* shape, IShapePool& pool);
+	void LinkSlot(uint32_t index);
+	void LinkSlotAfter(uint32_t index, uint32_t previous);
+
+	// Bulk submission, with either the caller's handles or new ones written to the optional output
+	template <typename T, typename Params>
+	void AddShapes(const Params* params, size_t count, const ShapeHandle* assigned, ShapeHandle* handles);
+
+	void ReserveSlots(size_t count);
+	ShapeSlot* GetSlot(ShapeHandle handle);
+	Group& GetGroup(uint32_t index) { return index != kNoSlot ? mGroups[index] : mRootGroup; }
+	const Group& GetGroup(uint32_t index) const { return index != kNoSlot ? mGroups[index] : mRootGroup; }
+	bool FindGroup(GroupHandle handle, uint32_t& index) const;
+	void InitializeGroup(uint32_t index, uint32_t parent);
+	void InvalidateGroupBounds(uint32_t group);
+	void UpdateGroups();
+	void FinishGroupBounds();
+	void DestroyShape(ShapeSlot& slot);
+	const TessellationData& GetTessellation(uint32_t slot);
+	bool IsTessellationUpToDate(uint32_t slot) const;
+	bool AllocateStyles(uint32_t slot);
+	void BuildTessellation(uint32_t slot, size_t vertexCount);
+	void RebuildTessellations();
+	void RebuildTessellationRange(size_t first, size_t last);
+	void BuildBatches();
+	void SortBatches();
+	void DrawBatches();
+	void AppendToBatch(const TessellationData& data);
+	void DrawBatchData();
+	void DrawTessellation(const TessellationData& data);
+	void WriteStyles(uint32_t slot);
+	void AccumulateCoverage(uint32_t slot, const Group& group);
+	void CloseCoverageRun();
+	void DrawCoverageRun(uint32_t run);
+	void UpdateViewRevision();
+
 	IRenderDevice* mRenderDevice = nullptr;
-	std::vector<const IVectorShape*> mShapes;
-};
+	std::vector<ShapeSlot> mSlots;
+	std::vector<uint32_t> mFreeSlots;
+	uint32_t mFirstSlot = kNoSlot;
+	uint32_t mLastSlot = kNoSlot;
+	std::vector<uint32_t> mVisibleSlots;
+	std::vector<Bounds> mVisibleBounds;
+
+	// Range of layer grid cells each visible shape covers, a byte per edge
+	std::vector<uint32_t> mVisibleCells;
+
+	// Batches of the visible slots, the batched entries index mVisibleSlots in drawing order
+	std::vector<DrawBatch> mBatches;
+	std::vector<uint32_t> mVisibleBatches;
+	std::vector<uint32_t> mBatchedEntries;
+
+	// Batches in submission order, sorted by layer and then by device state so batches with the same state meet
+	std::vector<uint64_t> mDrawKeys;
+	std::vector<uint64_t> mDrawKeyScratch;
+	std::vector<uint32_t> mLayerCells;
+	// Meshes of the batch being gathered, written straight into the device's buffers when it is drawn
+	std::vector<const TessellationData*> mBatchMeshes;
+	size_t mBatchVertexCount = 0;
+	size_t mBatchIndexCount = 0;
+	PrimitiveTopology mBatchTopology = PrimitiveTopology::TriangleList;
+	Bounds mBatchDataBounds;
+	std::unordered_map<std::type_index, std::unique_ptr<IShapePool>> mPools;
+
+	// Groups in an order with parents before their children, rebuilt when groups are added or removed
+	Group mRootGroup;
+	std::vector<Group> mGroups;
+	std::vector<uint32_t> mFreeGroups;
+	std::vector<uint32_t> mGroupOrder;
+	bool mGroupOrderDirty = false;
+	uint32_t mNextGroupGeneration = 0;
+	bool mExternalGroupHandles = false;
+
+	// Stale meshes rebuilt in parallel before drawing, split into one range of about the same work per thread
+	std::vector<uint32_t> mRebuildSlots;
+	std::vector<size_t> mRebuildVertexCounts;
+	std::vector<size_t> mRebuildOffsets;
+	std::vector<size_t> mRebuildSplits;
+
+	// Workers for the mesh rebuild and the draw key sort, shared with the other renderers in the process
+	ThreadPool& mThreadPool;
 
+	// Generation of newly created slots, kept past every handle given out so a cleared scene's handles stay stale
+	uint32_t mNextGeneration = 0;
+
+	// Handles come from the caller through the Insert functions
+	bool mExternalHandles = false;
+
+	// Version of the scene the slots show, which keeps their shapes alive
+	SceneSnapshot mScene;
+	std::vector<SceneSnapshot::Change> mSceneChanges;
+	std::vector<const SceneSnapshot::Change*> mSceneAdded;
+
+	// Colors of every retained mesh, uploaded before the first triangles of a frame in which any of them changed
+	std::vector<Style> mStyles;
+	std::vector<StyleRange> mFreeStyleRanges;
+	bool mStylesDirty = false;
+
+	// Level of detail, rebuilt every frame. The index only holds the cells of the open run.
+	std::vector<CoverageCell> mCoverageCells;
+	std::vector<CoverageRun> mCoverageRuns;
+	std::unordered_map<int64_t, size_t> mCoverageCellIndex;
+	bool mCoverageRunOpen = false;
+	PointCloud mCoverageMarkers;
+
+	Camera mCamera;
+	Camera mLastCamera;
+	int32_t mLastWidth = 0;
+	int32_t mLastHeight = 0;
+	uint32_t mViewRevision = 0;
+};
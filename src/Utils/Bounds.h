@@ -0,0 +1,47 @@
+#pragma once
+
+// Axis-aligned box in authored (world) space, empty until the first point is added.
+// Doubles to match world coordinates, which need the precision for deep zooms
+//------------------------------------------------------------------------------
+struct Bounds
+{
+	bool IsEmpty() const { return minX > maxX || minY > maxY; }
+
+	void Add(double x, double y)
+	{
+		minX = x < minX ? x : minX;
+		minY = y < minY ? y : minY;
+		maxX = x > maxX ? x : maxX;
+		maxY = y > maxY ? y : maxY;
+	}
+
+	void Add(const Bounds& other)
+	{
+		if (!other.IsEmpty())
+		{
+			Add(other.minX, other.minY);
+			Add(other.maxX, other.maxY);
+		}
+	}
+
+	void Inflate(double amount)
+	{
+		if (!IsEmpty())
+		{
+			minX -= amount;
+			minY -= amount;
+			maxX += amount;
+			maxY += amount;
+		}
+	}
+
+	bool Intersects(const Bounds& other) const
+	{
+		return minX <= other.maxX && other.minX <= maxX && minY <= other.maxY && other.minY <= maxY;
+	}
+
+	double minX = 1e300;
+	double minY = 1e300;
+	double maxX = -1e300;
+	double maxY = -1e300;
+};
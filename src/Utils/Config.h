@@ -4,5 +4,6 @@
 //------------------------------------------------------------------------------
 #define DEBUG 1
 #define RENDER_DOC 1
+#define STRESS_SCENE 0
 #define AUTHORED_WIDTH 1920
 #define AUTHORED_HEIGHT 1080
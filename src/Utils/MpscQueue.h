@@ -0,0 +1,68 @@
+#pragma once
+
+// System
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free queue for any number of producer threads and one consumer thread (Vyukov's intrusive MPSC
+// queue). Pushing is a single atomic exchange and never waits on the consumer. While a producer is between its
+// exchange and its link, the consumer sees the queue end there and picks up the rest on its next pop.
+//------------------------------------------------------------------------------
+template <typename T>
+class MpscQueue
+{
+public:
+	MpscQueue()
+		: mHead(new Node())
+		, mTail(mHead)
+	{
+	}
+
+	~MpscQueue()
+	{
+		while (mHead != nullptr)
+		{
+			Node* next = mHead->next.load(std::memory_order_relaxed);
+			delete mHead;
+			mHead = next;
+		}
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	// Any thread
+	void Push(T value)
+	{
+		Node* node = new Node();
+		node->value = std::move(value);
+		Node* previous = mTail.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	// Consumer only, returns false if the queue is empty
+	bool TryPop(T& value)
+	{
+		// The head is a consumed node, the next one holds the oldest item
+		Node* next = mHead->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+		{
+			return false;
+		}
+
+		value = std::move(next->value);
+		delete mHead;
+		mHead = next;
+		return true;
+	}
+
+private:
+	struct Node
+	{
+		T value;
+		std::atomic<Node*> next { nullptr };
+	};
+
+	Node* mHead = nullptr;			// Consumer side
+	std::atomic<Node*> mTail;		// Shared by the producers
+};
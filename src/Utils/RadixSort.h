@@ -0,0 +1,96 @@
+#pragma once
+
+// Utils
+#include <Utils/ThreadPool.h>
+
+// System
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// Below this many keys per thread, handing them to a worker costs more than it saves
+static const size_t kMinRadixSortKeysPerThread = 65536;
+
+// Sorts keys in ascending order, a byte at a time from the least significant one, using scratch as the second
+// buffer. Bytes that are the same in every key are skipped, so the cost follows the bits the keys actually use.
+// Large inputs are split between the pool's threads, each counting and then scattering its own share of every
+// pass. Without a pool everything runs on the caller.
+//------------------------------------------------------------------------------
+inline void RadixSort(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch, ThreadPool* pool = nullptr)
+{
+	const size_t count = keys.size();
+	if (count < 2)
+	{
+		return;
+	}
+	scratch.resize(count);
+
+	uint64_t varying = 0;
+	for (uint64_t key : keys)
+	{
+		varying |= key ^ keys[0];
+	}
+
+	const size_t threadCount = pool != nullptr ? std::min(pool->GetThreadCount(), count / kMinRadixSortKeysPerThread + 1) : 1;
+	std::vector<std::array<size_t, 256>> offsets(threadCount);
+	auto run = [pool, threadCount](const auto& function)
+	{
+		if (pool != nullptr)
+		{
+			pool->Run(threadCount, function);
+		}
+		else
+		{
+			function(0);
+		}
+	};
+
+	uint64_t* source = keys.data();
+	uint64_t* destination = scratch.data();
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		if (((varying >> shift) & 0xFF) == 0)
+		{
+			continue;
+		}
+
+		run([&](size_t t)
+		{
+			std::array<size_t, 256>& histogram = offsets[t];
+			histogram.fill(0);
+			for (size_t i = count * t / threadCount; i < count * (t + 1) / threadCount; ++i)
+			{
+				++histogram[(source[i] >> shift) & 0xFF];
+			}
+		});
+
+		// Each thread's keys with a given byte go after every smaller byte and after the earlier threads' keys with
+		// the same byte, which keeps the sort stable
+		size_t offset = 0;
+		for (size_t digit = 0; digit < 256; ++digit)
+		{
+			for (size_t t = 0; t < threadCount; ++t)
+			{
+				const size_t digitCount = offsets[t][digit];
+				offsets[t][digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		run([&](size_t t)
+		{
+			std::array<size_t, 256>& next = offsets[t];
+			for (size_t i = count * t / threadCount; i < count * (t + 1) / threadCount; ++i)
+			{
+				destination[next[(source[i] >> shift) & 0xFF]++] = source[i];
+			}
+		});
+		std::swap(source, destination);
+	}
+
+	if (source != keys.data())
+	{
+		keys.swap(scratch);
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+// System
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads started once and kept for the pool's lifetime, so work split between threads every frame doesn't
+// pay for creating and joining them. A job is split into parts that the workers and the calling thread take in
+// turn until none are left. One job runs at a time, a job started while another is running runs on its caller.
+//------------------------------------------------------------------------------
+class ThreadPool
+{
+public:
+	// Threads including the caller of Run, so a pool of one runs everything on the caller
+	explicit ThreadPool(size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u))
+	{
+		mWorkers.reserve(threadCount > 0 ? threadCount - 1 : 0);
+		for (size_t t = 1; t < threadCount; ++t)
+		{
+			mWorkers.emplace_back(&ThreadPool::WorkerMain, this);
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mWake.notify_all();
+		for (std::thread& worker : mWorkers)
+		{
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t GetThreadCount() const { return mWorkers.size() + 1; }
+
+	// One pool for the whole process, so several renderers (such as the canvases of a wall) share the cores rather
+	// than each starting a thread per core
+	static ThreadPool& GetShared()
+	{
+		static ThreadPool shared;
+		return shared;
+	}
+
+	// Calls function(part) for every part below partCount and returns once they have all finished. Parts may run
+	// in any order and on any thread.
+	template <typename Function>
+	void Run(size_t partCount, const Function& function)
+	{
+		// Everything runs on the caller as well while the pool is busy with another job, including from within a
+		// part of that job
+		std::unique_lock<std::mutex> runLock(mRunMutex, std::try_to_lock);
+		if (mWorkers.empty() || partCount < 2 || !runLock.owns_lock())
+		{
+			for (size_t part = 0; part < partCount; ++part)
+			{
+				function(part);
+			}
+			return;
+		}
+
+		// The caller takes parts as well, so only as many workers are woken as there are parts left for them
+		const size_t helpers = std::min(partCount - 1, mWorkers.size());
+		const std::function<void(size_t)> job = std::cref(function);
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mJob = &job;
+			mPartCount = partCount;
+			mNextPart.store(0, std::memory_order_relaxed);
+			mOpenSlots = helpers;
+			mBusyWorkers = helpers;
+		}
+		for (size_t i = 0; i < helpers; ++i)
+		{
+			mWake.notify_one();
+		}
+
+		RunParts(job);
+
+		// Slots no worker has woken up for yet aren't waited on, there is nothing left for them to do
+		std::unique_lock<std::mutex> lock(mMutex);
+		mBusyWorkers -= mOpenSlots;
+		mOpenSlots = 0;
+		mDone.wait(lock, [this] { return mBusyWorkers == 0; });
+		mJob = nullptr;
+	}
+
+private:
+	void WorkerMain()
+	{
+		for (;;)
+		{
+			const std::function<void(size_t)>* job = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWake.wait(lock, [this] { return mStopping || mOpenSlots > 0; });
+				if (mStopping)
+				{
+					return;
+				}
+				--mOpenSlots;
+				job = mJob;
+			}
+
+			RunParts(*job);
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (--mBusyWorkers == 0)
+			{
+				mDone.notify_one();
+			}
+		}
+	}
+
+	void RunParts(const std::function<void(size_t)>& job)
+	{
+		for (size_t part = mNextPart.fetch_add(1, std::memory_order_relaxed); part < mPartCount; part = mNextPart.fetch_add(1, std::memory_order_relaxed))
+		{
+			job(part);
+		}
+	}
+
+	std::vector<std::thread> mWorkers;
+	std::mutex mRunMutex;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+
+	// The current job, set under the mutex before the workers are woken. Each woken worker takes one of the open
+	// slots, and the job is over once every slot taken has been given back.
+	const std::function<void(size_t)>* mJob = nullptr;
+	size_t mPartCount = 0;
+	std::atomic<size_t> mNextPart{ 0 };
+	size_t mOpenSlots = 0;
+	size_t mBusyWorkers = 0;
+	bool mStopping = false;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Bounds.h"
+
+// System
+#include <cmath>
+
+// Places a group in its parent's space: uniform scale, then rotation, then translation. Limited to similarity
+// transforms so the view from inside a group is still a Camera, which shapes use for their level of detail and
+// devices for their fast paths.
+//------------------------------------------------------------------------------
+struct Transform
+{
+	bool IsIdentity() const { return x == 0.0 && y == 0.0 && rotation == 0.0 && scale == 1.0; }
+
+	void Apply(double& px, double& py) const
+	{
+		const double c = std::cos(rotation) * scale;
+		const double s = std::sin(rotation) * scale;
+		const double tx = c * px - s * py + x;
+		py = s * px + c * py + y;
+		px = tx;
+	}
+
+	void ApplyInverse(double& px, double& py) const
+	{
+		const double c = std::cos(rotation) / scale;
+		const double s = std::sin(rotation) / scale;
+		const double dx = px - x;
+		const double dy = py - y;
+		px = c * dx + s * dy;
+		py = -s * dx + c * dy;
+	}
+
+	// Box around the transformed box
+	Bounds Apply(const Bounds& bounds) const
+	{
+		Bounds result;
+		if (bounds.IsEmpty())
+		{
+			return result;
+		}
+
+		const double corners[][2] =
+		{
+			{ bounds.minX, bounds.minY },
+			{ bounds.maxX, bounds.minY },
+			{ bounds.minX, bounds.maxY },
+			{ bounds.maxX, bounds.maxY }
+		};
+		for (const auto& corner : corners)
+		{
+			double px = corner[0];
+			double py = corner[1];
+			Apply(px, py);
+			result.Add(px, py);
+		}
+		return result;
+	}
+
+	// Child's space straight to the space the parent is placed in
+	static Transform Combine(const Transform& parent, const Transform& child)
+	{
+		Transform result;
+		result.x = child.x;
+		result.y = child.y;
+		parent.Apply(result.x, result.y);
+		result.rotation = parent.rotation + child.rotation;
+		result.scale = parent.scale * child.scale;
+		return result;
+	}
+
+	double x = 0.0;
+	double y = 0.0;
+	double rotation = 0.0;
+	double scale = 1.0;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "VectorShape.h"
+
+// System
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Whether clearing a pool may drop its pages without running the destructors of the shapes still in it. Only
+// true for shapes made of plain values, a shape that owns memory has to give it back first.
+//------------------------------------------------------------------------------
+template <typename T>
+struct IsTriviallyReleasable
+{
+	static const bool value = false;
+};
+
+template <> struct IsTriviallyReleasable<Line> { static const bool value = true; };
+template <> struct IsTriviallyReleasable<Rect> { static const bool value = true; };
+template <> struct IsTriviallyReleasable<BezierCurve> { static const bool value = true; };
+template <> struct IsTriviallyReleasable<CubicBezierCurve> { static const bool value = true; };
+
+// Type-erased side of a ShapePool, so shapes of any type can be given back to the pool they came from
+//------------------------------------------------------------------------------
+class IShapePool
+{
+public:
+	virtual ~IShapePool() = default;
+
+	// Runs the destructor and puts the storage on the free list
+	virtual void Destroy(const IVectorShape* shape) = 0;
+
+	// Releases every page at once. Shapes still in the pool must have been destroyed first unless the pool is
+	// trivially releasable.
+	virtual void Clear() = 0;
+	virtual bool IsTriviallyReleasable() const = 0;
+};
+
+// Allocates shapes of a single type from fixed-size pages. Freed storage is reused before a new page is taken,
+// and the pages are only returned to the heap when the pool is cleared.
+//------------------------------------------------------------------------------
+template <typename T>
+class ShapePool : public IShapePool
+{
+public:
+	static const size_t kShapesPerPage = 1024;
+
+	template <typename... Args>
+	T* Create(Args&&... args)
+	{
+		void* storage = mFreeList;
+		if (storage != nullptr)
+		{
+			mFreeList = *static_cast<void**>(storage);
+		}
+		else
+		{
+			if (mPages.empty() || mPageUsed == kShapesPerPage)
+			{
+				mPages.emplace_back(new Storage[kShapesPerPage]);
+				mPageUsed = 0;
+			}
+			storage = &mPages.back()[mPageUsed++];
+		}
+		return new (storage) T(std::forward<Args>(args)...);
+	}
+
+	virtual void Destroy(const IVectorShape* shape) override
+	{
+		const T* typed = static_cast<const T*>(shape);
+		typed->~T();
+
+		// The first bytes of a freed shape link it into the free list
+		void* storage = const_cast<T*>(typed);
+		*static_cast<void**>(storage) = mFreeList;
+		mFreeList = storage;
+	}
+
+	virtual void Clear() override
+	{
+		mPages.clear();
+		mPageUsed = 0;
+		mFreeList = nullptr;
+	}
+
+	virtual bool IsTriviallyReleasable() const override { return ::IsTriviallyReleasable<T>::value; }
+
+private:
+	struct alignas(T) Storage
+	{
+		unsigned char bytes[sizeof(T)];
+	};
+	static_assert(sizeof(Storage) >= sizeof(void*), "Shape too small to hold a free list link");
+
+	std::vector<std::unique_ptr<Storage[]>> mPages;
+	size_t mPageUsed = 0;
+	void* mFreeList = nullptr;
+};
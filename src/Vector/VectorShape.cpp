@@ -1,6 +1,10 @@
 #include "VectorShape.h"
 
+// Renderer
+#include <Renderer/Camera.h>
+
 // Utils
+#include <Utils/Assert.h>
 #include <Utils/Config.h>
 
 // External
@@ -8,8 +12,342 @@
 
 // System
 #include <stdint.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+// 16-bit indices with 4 vertices per marker, for devices that can't instance
+static const size_t kMaxTessellatedMarkers = std::numeric_limits<uint16_t>::max() / 4;
+
+// 16-bit indices with 2 vertices per PolyLine point, 4 where a sharp turn is beveled. The highest index stays
+// below kStripRestartIndex.
+static const size_t kMaxPolyLinePoints = std::numeric_limits<uint16_t>::max() / 2;
+static const size_t kMaxPolyLineVertices = kMaxPolyLinePoints * 2;
+
+// Widest decimation whose output still fits, four points per column plus the column at the right edge and one
+// point past either side. Wider views are decimated to columns of more than a pixel.
+static const int32_t kMaxPolyLineColumns = static_cast<int32_t>((kMaxPolyLinePoints - 2) / 4) - 1;
+
+// Longest a join may extend the stroke, in half widths, before sharper turns are beveled
+static const float kMaxMiterLength = 2.0f;
+
+// Post-transform vertex cache size assumed by the index reordering, GPUs have at least this many entries
+static const int32_t kVertexCacheSize = 32;
+
+
+//------------------------------------------------------------------------------
+// World space position as a float offset from the render origin, so precision follows the view rather than the
+// distance from the world origin
+static Vertex OriginVertex(double x, double y, double originX, double originY, uint32_t style)
+{
+	return Vertex(static_cast<float>(x - originX), static_cast<float>(y - originY), 0.0f, style);
+}
+
+//------------------------------------------------------------------------------
+struct VertexHash
+{
+	size_t operator()(const Vertex& vertex) const
+	{
+		// FNV-1a over the raw bytes, equality is bitwise too
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&vertex);
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(Vertex); ++i)
+		{
+			hash = (hash ^ bytes[i]) * 16777619u;
+		}
+		return hash;
+	}
+};
+
+//------------------------------------------------------------------------------
+struct VertexEqual
+{
+	bool operator()(const Vertex& a, const Vertex& b) const
+	{
+		return memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+};
+
+//------------------------------------------------------------------------------
+// Forsyth's score, favoring recently used vertices and those with few triangles left
+static float VertexCacheScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle's own vertices score a bit lower so the order doesn't fold back on itself
+		score = cachePosition < 3 ? 0.75f : std::pow(1.0f - (cachePosition - 3) / static_cast<float>(kVertexCacheSize - 3), 1.5f);
+	}
+	return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+//------------------------------------------------------------------------------
+// Greedy triangle reordering (Forsyth, "Linear-Speed Vertex Cache Optimisation") against an LRU cache
+static void OptimizeVertexCache(std::vector<uint16_t>& indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+
+	// Triangles using each vertex, packed into one list. The first remaining[v] entries are the unadded ones
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint16_t index : indices)
+	{
+		++remaining[index];
+	}
+	std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+	}
+	std::vector<uint32_t> vertexTriangles(indices.size());
+	std::vector<uint32_t> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		for (size_t k = 0; k < 3; ++k)
+		{
+			vertexTriangles[cursor[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+		}
+	}
+
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		vertexScore[v] = VertexCacheScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> added(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint16_t> ordered;
+	ordered.reserve(triangleCount * 3);
+
+	uint16_t cache[kVertexCacheSize + 3];
+	int32_t cacheCount = 0;
+	size_t nextUnadded = 0;
+	int64_t best = -1;
+	for (size_t n = 0; n < triangleCount; ++n)
+	{
+		// Nothing in the cache has triangles left, move on in the original order
+		if (best < 0)
+		{
+			while (added[nextUnadded])
+			{
+				++nextUnadded;
+			}
+			best = static_cast<int64_t>(nextUnadded);
+		}
+
+		const size_t triangle = static_cast<size_t>(best);
+		added[triangle] = true;
+
+		uint16_t newCache[kVertexCacheSize + 3];
+		int32_t newCacheCount = 0;
+		for (size_t k = 0; k < 3; ++k)
+		{
+			const uint16_t vertex = indices[triangle * 3 + k];
+			ordered.push_back(vertex);
+			newCache[newCacheCount++] = vertex;
+
+			// Swap the triangle out of the vertex's unadded range
+			uint32_t* first = vertexTriangles.data() + firstTriangle[vertex];
+			uint32_t* last = first + remaining[vertex] - 1;
+			*std::find(first, last + 1, static_cast<uint32_t>(triangle)) = *last;
+			*last = static_cast<uint32_t>(triangle);
+			--remaining[vertex];
+		}
+
+		// Most recently used first, the ones pushed past the end are evicted
+		for (int32_t i = 0; i < cacheCount; ++i)
+		{
+			const uint16_t vertex = cache[i];
+			if (vertex != newCache[0] && vertex != newCache[1] && vertex != newCache[2])
+			{
+				newCache[newCacheCount++] = vertex;
+			}
+		}
+
+		best = -1;
+		float bestScore = -1.0f;
+		for (int32_t i = 0; i < newCacheCount; ++i)
+		{
+			const uint16_t vertex = newCache[i];
+			cachePosition[vertex] = i < kVertexCacheSize ? i : -1;
+			const float score = VertexCacheScore(cachePosition[vertex], remaining[vertex]);
+			const float delta = score - vertexScore[vertex];
+			vertexScore[vertex] = score;
+
+			const uint32_t* triangles = vertexTriangles.data() + firstTriangle[vertex];
+			for (uint32_t j = 0; j < remaining[vertex]; ++j)
+			{
+				const uint32_t candidate = triangles[j];
+				triangleScore[candidate] += delta;
+				if (triangleScore[candidate] > bestScore)
+				{
+					best = candidate;
+					bestScore = triangleScore[candidate];
+				}
+			}
+		}
+
+		cacheCount = std::min(newCacheCount, kVertexCacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+
+	indices.swap(ordered);
+}
+
+//------------------------------------------------------------------------------
+void TessellationData::Optimize()
+{
+	// Already in cache order, and zero-area triangles are how a strip turns
+	if (topology == PrimitiveTopology::TriangleStrip)
+	{
+		return;
+	}
+
+	// Weld bitwise-identical vertices
+	std::unordered_map<Vertex, uint16_t, VertexHash, VertexEqual> unique;
+	unique.reserve(vertices.size());
+	std::vector<uint16_t> remap(vertices.size());
+	std::vector<Vertex> welded;
+	welded.reserve(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto result = unique.emplace(vertices[i], static_cast<uint16_t>(welded.size()));
+		if (result.second)
+		{
+			welded.push_back(vertices[i]);
+		}
+		remap[i] = result.first->second;
+	}
 
+	// Strip triangles that are out of range, not finite or have no area
+	std::vector<uint16_t> kept;
+	kept.reserve(indices.size());
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		if (indices[i] >= vertices.size() || indices[i + 1] >= vertices.size() || indices[i + 2] >= vertices.size())
+		{
+			ASSERT(false, "Index out of range");
+			continue;
+		}
+
+		const uint16_t i0 = remap[indices[i]];
+		const uint16_t i1 = remap[indices[i + 1]];
+		const uint16_t i2 = remap[indices[i + 2]];
+		if (i0 == i1 || i1 == i2 || i0 == i2)
+		{
+			continue;
+		}
+
+		const Vertex& v0 = welded[i0];
+		const Vertex& v1 = welded[i1];
+		const Vertex& v2 = welded[i2];
+		const float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+		if (!(area != 0.0f) || !std::isfinite(area))
+		{
+			continue;
+		}
+
+		kept.push_back(i0);
+		kept.push_back(i1);
+		kept.push_back(i2);
+	}
+
+	OptimizeVertexCache(kept, welded.size());
+
+	// Vertices in order of first use so fetches walk the buffer forwards, unused ones dropped
+	std::vector<int32_t> order(welded.size(), -1);
+	vertices.clear();
+	for (uint16_t& index : kept)
+	{
+		if (order[index] < 0)
+		{
+			order[index] = static_cast<int32_t>(vertices.size());
+			vertices.push_back(welded[index]);
+		}
+		index = static_cast<uint16_t>(order[index]);
+	}
+	indices.swap(kept);
+}
+
+//------------------------------------------------------------------------------
+TessellationDataSink::TessellationDataSink(TessellationData& data, uint32_t baseStyle)
+	: mData(data)
+	, mBaseStyle(baseStyle)
+{
+	// Keeps the capacity of whatever was there before
+	mData.vertices.clear();
+	mData.indices.clear();
+	mData.topology = PrimitiveTopology::TriangleList;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool TessellationDataSink::Reserve(size_t vertexCount, size_t indexCount, PrimitiveTopology topology, TessellationSpan& span)
+{
+	if (mData.indices.empty())
+	{
+		mData.topology = topology;
+	}
+	else if (topology != mData.topology)
+	{
+		ASSERT(false, "Mixing primitive topologies in one tessellation");
+		return false;
+	}
+
+	// 16-bit indices, the highest one stays below kStripRestartIndex
+	mVertexStart = mData.vertices.size();
+	mIndexStart = mData.indices.size();
+	if (mVertexStart + vertexCount > kStripRestartIndex)
+	{
+		ASSERT(false, "Tessellation exceeds the 16-bit index range");
+		mRestartCount = 0;
+		return false;
+	}
+
+	mRestartCount = topology == PrimitiveTopology::TriangleStrip && mIndexStart > 0 ? 1 : 0;
+	mData.vertices.resize(mVertexStart + vertexCount);
+	mData.indices.resize(mIndexStart + mRestartCount + indexCount);
+	if (mRestartCount > 0)
+	{
+		mData.indices[mIndexStart] = kStripRestartIndex;
+	}
+
+	span.vertices = mData.vertices.data() + mVertexStart;
+	span.indices = mData.indices.data() + mIndexStart + mRestartCount;
+	span.baseVertex = static_cast<uint16_t>(mVertexStart);
+	span.baseStyle = mBaseStyle;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void TessellationDataSink::Commit(size_t vertexCount, size_t indexCount)
+{
+	// A shape that emitted nothing doesn't need its restart either
+	mData.vertices.resize(mVertexStart + vertexCount);
+	mData.indices.resize(indexCount > 0 ? mIndexStart + mRestartCount + indexCount : mIndexStart);
+}
+
+//------------------------------------------------------------------------------
+const uint32_t IVectorShape::kStrokeStyle;
+const uint32_t IVectorShape::kFillStyle;
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool IVectorShape::DrawDirect(IRenderDevice* renderDevice) const
+{
+	return false;
+}
 
 //------------------------------------------------------------------------------
 /*virtual*/ void IVectorShape::SetStroke(float r, float g, float b, float a, float width)
@@ -18,7 +356,14 @@
 	strokeG = g;
 	strokeB = b;
 	strokeA = a;
-	strokeWidth = width;
+	InvalidateStyles();
+
+	// Colors live in the style palette, only the width changes the geometry and bounds
+	if (width != strokeWidth)
+	{
+		strokeWidth = width;
+		Invalidate();
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -28,10 +373,45 @@
 	fillG = g;
 	fillB = b;
 	fillA = a;
+
+	// Picked up from the style palette, no need to re-tessellate
+	InvalidateStyles();
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void IVectorShape::GetStyles(Style* styles) const
+{
+	styles[kStrokeStyle].r = strokeR;
+	styles[kStrokeStyle].g = strokeG;
+	styles[kStrokeStyle].b = strokeB;
+	styles[kStrokeStyle].a = strokeA;
+
+	styles[kFillStyle].r = fillR;
+	styles[kFillStyle].g = fillG;
+	styles[kFillStyle].b = fillB;
+	styles[kFillStyle].a = fillA;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ Style IVectorShape::GetCoverage(double pixelsPerUnit) const
+{
+	// Filled shapes cover their box, stroked ones their length times the stroke width
+	const Bounds& bounds = GetBounds();
+	const double width = (bounds.maxX - bounds.minX) * pixelsPerUnit;
+	const double height = (bounds.maxY - bounds.minY) * pixelsPerUnit;
+	const bool filled = fillA > 0.0f;
+	const double area = filled ? width * height : std::max(width, height) * strokeWidth * pixelsPerUnit;
+
+	Style coverage;
+	coverage.r = filled ? fillR : strokeR;
+	coverage.g = filled ? fillG : strokeG;
+	coverage.b = filled ? fillB : strokeB;
+	coverage.a = static_cast<float>(std::min(area, 1.0)) * (filled ? fillA : strokeA);
+	return coverage;
 }
 
 //------------------------------------------------------------------------------
-Line::Line(float x1, float y1, float x2, float y2)
+Line::Line(double x1, double y1, double x2, double y2)
 	: x1(x1)
 	, y1(y1)
 	, x2(x2)
@@ -40,45 +420,85 @@ Line::Line(float x1, float y1, float x2, float y2)
 }
 
 //------------------------------------------------------------------------------
-/*virtual*/ TessellationData Line::Tessellate(IRenderDevice* renderDevice) const
+/*virtual*/ void Line::Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const
 {
 	using namespace Eigen;
 
-	TessellationData data;
+	double originX = 0.0;
+	double originY = 0.0;
+	renderDevice->GetCamera().GetOrigin(originX, originY);
 
-	float halfWidth = strokeWidth * 0.5f;
+	const double halfWidth = strokeWidth * 0.5;
 
 	// Calculate the normal for the line's width
-	float dx = x2 - x1;
-	float dy = y2 - y1;
-	float length = std::sqrt(dx * dx + dy + dy);
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+	double length = std::sqrt(dx * dx + dy * dy);
+	if (!(length > 0.0))
+	{
+		// No direction to extrude along, and butt ends cover nothing
+		return;
+	}
 	dx /= length;
 	dy /= length;
 
 	// Normal vectors for width
-	const float px = -dy * halfWidth;
-	const float py = dx * halfWidth;
+	const double px = -dy * halfWidth;
+	const double py = dx * halfWidth;
+
+	TessellationSpan span;
+	if (!sink.Reserve(4, 4, PrimitiveTopology::TriangleStrip, span))
+	{
+		return;
+	}
 
 	// Four corners of the quad
-	const Vertex vertices[] =
+	const uint32_t style = span.baseStyle + kStrokeStyle;
+	span.vertices[0] = OriginVertex(x1 + px, y1 + py, originX, originY, style);
+	span.vertices[1] = OriginVertex(x1 - px, y1 - py, originX, originY, style);
+	span.vertices[2] = OriginVertex(x2 + px, y2 + py, originX, originY, style);
+	span.vertices[3] = OriginVertex(x2 - px, y2 - py, originX, originY, style);
+
+	// Two triangles as a strip
+	for (uint16_t i = 0; i < 4; ++i)
 	{
-		Vertex(x1 + px, y1 + py, 0.0f, strokeR, strokeG, strokeB, strokeA),
-		Vertex(x1 - px, y1 - py, 0.0f, strokeR, strokeG, strokeB, strokeA),
-		Vertex(x2 + px, y2 + py, 0.0f, strokeR, strokeG, strokeB, strokeA),
-		Vertex(x2 - px, y2 - py, 0.0f, strokeR, strokeG, strokeB, strokeA)
-	};
-	data.SetVertices(vertices, sizeof(vertices));
+		span.indices[i] = span.baseVertex + i;
+	}
+	sink.Commit(4, 4);
+}
 
-	// Indices for the two triangles
-	uint16_t indices[] = { 0, 1, 2, 1, 3, 2 };
-	data.SetIndices(indices, sizeof(indices));
+//------------------------------------------------------------------------------
+/*virtual*/ void Line::GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const
+{
+	vertexCount = 4;
+	indexCount = 4;
+}
 
-	data.Normalize();
-	return data;
+//------------------------------------------------------------------------------
+/*virtual*/ bool Line::DrawDirect(IRenderDevice* renderDevice) const
+{
+	// The device decides from the screen-space width whether this is thin enough to be a hairline
+	return renderDevice->DrawHairline(x1, y1, x2, y2, strokeWidth, strokeR, strokeG, strokeB, strokeA);
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool Line::HasDirectPath(IRenderDevice* renderDevice) const
+{
+	return renderDevice->HasDirectHairlines();
 }
 
 //------------------------------------------------------------------------------
-Rect::Rect(float x, float y, float width, float height)
+/*virtual*/ Bounds Line::ComputeBounds() const
+{
+	Bounds bounds;
+	bounds.Add(x1, y1);
+	bounds.Add(x2, y2);
+	bounds.Inflate(strokeWidth * 0.5f);
+	return bounds;
+}
+
+//------------------------------------------------------------------------------
+Rect::Rect(double x, double y, double width, double height)
 	: x(x)
 	, y(y)
 	, width(width)
@@ -87,32 +507,67 @@ Rect::Rect(float x, float y, float width, float height)
 }
 
 //------------------------------------------------------------------------------
-/*virtual*/ TessellationData Rect::Tessellate(IRenderDevice* renderDevice) const
+/*virtual*/ void Rect::Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const
 {
 	using namespace Eigen;
 
-	TessellationData data;
+	double originX = 0.0;
+	double originY = 0.0;
+	renderDevice->GetCamera().GetOrigin(originX, originY);
 
-	// Four corners of the rectangle
-	const Vertex vertices[] =
+	TessellationSpan span;
+	if (!sink.Reserve(4, 6, PrimitiveTopology::TriangleList, span))
 	{
-		Vertex(x, y, 0.0f, fillR, fillG, fillB, fillA),						// Bottom-left
-		Vertex(x + width, y, 0.0f, fillR, fillG, fillB, fillA),				// Bottom-right
-		Vertex(x + width, y + height, 0.0f, fillR, fillG, fillB, fillA),	// Top-right
-		Vertex(x, y + height, 0.0f, fillR, fillG, fillB, fillA),			// Top-left
-	};
-	data.SetVertices(vertices, sizeof(vertices));
+		return;
+	}
+
+	// Four corners of the rectangle
+	const uint32_t style = span.baseStyle + kFillStyle;
+	span.vertices[0] = OriginVertex(x, y, originX, originY, style);						// Bottom-left
+	span.vertices[1] = OriginVertex(x + width, y, originX, originY, style);				// Bottom-right
+	span.vertices[2] = OriginVertex(x + width, y + height, originX, originY, style);		// Top-right
+	span.vertices[3] = OriginVertex(x, y + height, originX, originY, style);				// Top-left
 
 	// Indices for the two triangles
-	uint16_t indices[] = { 0, 1, 2, 0, 2, 3 };
-	data.SetIndices(indices, sizeof(indices));
+	const uint16_t indices[] = { 0, 1, 2, 0, 2, 3 };
+	for (size_t i = 0; i < 6; ++i)
+	{
+		span.indices[i] = span.baseVertex + indices[i];
+	}
+	sink.Commit(4, 6);
+}
 
-	data.Normalize();
-	return data;
+//------------------------------------------------------------------------------
+/*virtual*/ void Rect::GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const
+{
+	vertexCount = 4;
+	indexCount = 6;
 }
 
 //------------------------------------------------------------------------------
-BezierCurve::BezierCurve(float x1, float y1, float x2, float y2, float cx1, float cy1)
+/*virtual*/ bool Rect::DrawDirect(IRenderDevice* renderDevice) const
+{
+	// Axis-aligned, so the device can span fill it without any triangle setup
+	return renderDevice->FillRect(x, y, width, height, fillR, fillG, fillB, fillA);
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool Rect::HasDirectPath(IRenderDevice* renderDevice) const
+{
+	return renderDevice->HasDirectRects();
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ Bounds Rect::ComputeBounds() const
+{
+	Bounds bounds;
+	bounds.Add(x, y);
+	bounds.Add(x + width, y + height);
+	return bounds;
+}
+
+//------------------------------------------------------------------------------
+BezierCurve::BezierCurve(double x1, double y1, double x2, double y2, double cx1, double cy1)
 	: x1(x1)
 	, y1(y1)
 	, x2(x2)
@@ -123,68 +578,119 @@ BezierCurve::BezierCurve(float x1, float y1, float x2, float y2, float cx1, floa
 }
 
 //------------------------------------------------------------------------------
-/*virtual*/ TessellationData BezierCurve::Tessellate(IRenderDevice* renderDevice) const
+/*virtual*/ void BezierCurve::Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const
 {
-	TessellationData data;
+	double originX = 0.0;
+	double originY = 0.0;
+	renderDevice->GetCamera().GetOrigin(originX, originY);
 
-	static const int kSegments = 20;		// TODO: Allow this to be set for quality/performance tradeoff
-	Vertex vertices[(kSegments + 1) * 2];	// Position + Fill color, 2 per segment: curve and baseline
-	uint16_t indices[kSegments * 6];		// Two triangles per segment
-	
-	int32_t vertexIndex = 0;
-	int32_t indexIndex = 0;
+	const int32_t segments = GetSegmentCount(renderDevice);
 
-	for (int32_t i = 0; i <= kSegments; ++i)
+	// 2 vertices per segment: curve and baseline
+	const size_t vertexCount = static_cast<size_t>(segments + 1) * 2;
+	TessellationSpan span;
+	if (!sink.Reserve(vertexCount, vertexCount, PrimitiveTopology::TriangleStrip, span))
 	{
-		const float t = (float)i / kSegments;
-		float x = 0.0f;
-		float y = 0.0f;
+		return;
+	}
+
+	const uint32_t style = span.baseStyle + kStrokeStyle;
+	Vertex* vertex = span.vertices;
+	for (int32_t i = 0; i <= segments; ++i)
+	{
+		const double t = (double)i / segments;
+		double x = 0.0;
+		double y = 0.0;
 		ComputeXY(t, x, y);
 
 		// Primary vertex (on the curve)
-		vertices[vertexIndex++] = Vertex(x, y, 0.0f, strokeR, strokeG, strokeB, strokeA);
+		*vertex++ = OriginVertex(x, y, originX, originY, style);
 		
 		// Baseline vertex (offset slightly downwards)
-		vertices[vertexIndex++] = Vertex(x, y - strokeWidth, 0.0f, strokeR, strokeG, strokeB, strokeA);
-
-		// Store indices
-		if (i < kSegments)
-		{
-			// Two triangles for the segment
-			uint16_t topLeft = i * 2;
-			uint16_t topRight = topLeft + 2;
-			uint16_t bottomLeft = topLeft + 1;
-			uint16_t bottomRight = topRight + 1;
-
-			// First triangle (top-left, bottom-left, top-right)
-			indices[indexIndex++] = topLeft;
-			indices[indexIndex++] = bottomLeft;
-			indices[indexIndex++] = topRight;
+		*vertex++ = OriginVertex(x, y - strokeWidth, originX, originY, style);
+	}
 
-			// Second triangle (bottom-left, bottom-right, top-right)
-			indices[indexIndex++] = bottomLeft;
-			indices[indexIndex++] = bottomRight;
-			indices[indexIndex++] = topRight;
-		}
+	// Curve and baseline vertices alternate, so the segments form one strip in vertex order
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		span.indices[i] = static_cast<uint16_t>(span.baseVertex + i);
 	}
+	sink.Commit(vertexCount, vertexCount);
+}
 
-	data.SetVertices(vertices, sizeof(vertices));
-	data.SetIndices(indices, sizeof(indices));
+//------------------------------------------------------------------------------
+/*virtual*/ void BezierCurve::GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const
+{
+	vertexCount = static_cast<size_t>(GetSegmentCount(renderDevice) + 1) * 2;
+	indexCount = vertexCount;
+}
 
-	data.Normalize();
-	return data;
+//------------------------------------------------------------------------------
+int32_t BezierCurve::GetSegmentCount(IRenderDevice* renderDevice) const
+{
+	// Flattening error falls with the square of the segment count, so sqrt of the on-screen length keeps it
+	// under a pixel. The length is estimated from a coarse sampling of the curve.
+	static const int32_t kMinSegments = 2;
+	static const int32_t kMaxSegments = 64;
+	static const int32_t kLengthSamples = 8;
+	double length = 0.0;
+	double previousX = x1;
+	double previousY = y1;
+	for (int32_t i = 1; i <= kLengthSamples; ++i)
+	{
+		double x = 0.0;
+		double y = 0.0;
+		ComputeXY((double)i / kLengthSamples, x, y);
+		length += std::sqrt((x - previousX) * (x - previousX) + (y - previousY) * (y - previousY));
+		previousX = x;
+		previousY = y;
+	}
+	const double pixelLength = length * renderDevice->GetCamera().GetPixelsPerUnit(static_cast<float>(renderDevice->GetWidth()));
+	return static_cast<int32_t>(std::min(std::max(std::ceil(std::sqrt(pixelLength)), (double)kMinSegments), (double)kMaxSegments));
 }
 
 //------------------------------------------------------------------------------
-void BezierCurve::ComputeXY(float t, float& x, float& y) const
+void BezierCurve::ComputeXY(double t, double& x, double& y) const
 {
 	// Quadratic Bezier interpolation (De Casteljau's algorithm)
-	x = (1.0f - t) * (1.0f - t) * x1 + 2 * (1.0f - t) * t * cx1 + t * t * x2;
-	y = (1.0f - t) * (1.0f - t) * y1 + 2 * (1.0f - t) * t * cy1 + t * t * y2;
+	x = (1.0 - t) * (1.0 - t) * x1 + 2 * (1.0 - t) * t * cx1 + t * t * x2;
+	y = (1.0 - t) * (1.0 - t) * y1 + 2 * (1.0 - t) * t * cy1 + t * t * y2;
 }
 
 //------------------------------------------------------------------------------
-CubicBezierCurve::CubicBezierCurve(float x1, float y1, float x2, float y2, float cx1, float cy1, float cx2, float cy2)
+/*virtual*/ Bounds BezierCurve::ComputeBounds() const
+{
+	Bounds bounds;
+	bounds.Add(x1, y1);
+	bounds.Add(x2, y2);
+
+	// Extrema are where the derivative 2((1 - t)(c - p1) + t(p2 - c)) is zero, per axis
+	const double denominators[] = { x1 - 2.0 * cx1 + x2, y1 - 2.0 * cy1 + y2 };
+	const double numerators[] = { x1 - cx1, y1 - cy1 };
+	for (int32_t axis = 0; axis < 2; ++axis)
+	{
+		if (denominators[axis] == 0.0)
+		{
+			continue;
+		}
+
+		const double t = numerators[axis] / denominators[axis];
+		if (t > 0.0 && t < 1.0)
+		{
+			double x = 0.0;
+			double y = 0.0;
+			BezierCurve::ComputeXY(t, x, y);
+			bounds.Add(x, y);
+		}
+	}
+
+	// The stroke is extruded by its full width from the curve
+	bounds.Inflate(strokeWidth);
+	return bounds;
+}
+
+//------------------------------------------------------------------------------
+CubicBezierCurve::CubicBezierCurve(double x1, double y1, double x2, double y2, double cx1, double cy1, double cx2, double cy2)
 	: BezierCurve(x1, y1, x2, y2, cx1, cy1)
 	, cx2(cx2)
 	, cy2(cy2)
@@ -192,15 +698,595 @@ CubicBezierCurve::CubicBezierCurve(float x1, float y1, float x2, float y2, float
 }
 
 //------------------------------------------------------------------------------
-/*virtual*/ void CubicBezierCurve::ComputeXY(float t, float& x, float& y) const
+/*virtual*/ void CubicBezierCurve::ComputeXY(double t, double& x, double& y) const
 {
 	// Cubic Bezier interpolation (De Casteljau's algorithm)
-	x = (1.0f - t) * (1.0f - t) * (1.0f - t) * x1
-	  + 3 * (1.0f - t) * (1.0f - t) * t * cx1
-	  + 3 * (1.0f - t) * t * t * cx2 + t * t * t * x2;
-	y = (1.0f - t) * (1.0f - t) * (1.0f - t) * y1
-	  + 3 * (1.0f - t) * (1.0f - t) * t * cy1
-	  + 3 * (1.0f - t) * t * t * cy2
+	x = (1.0 - t) * (1.0 - t) * (1.0 - t) * x1
+	  + 3 * (1.0 - t) * (1.0 - t) * t * cx1
+	  + 3 * (1.0 - t) * t * t * cx2 + t * t * t * x2;
+	y = (1.0 - t) * (1.0 - t) * (1.0 - t) * y1
+	  + 3 * (1.0 - t) * (1.0 - t) * t * cy1
+	  + 3 * (1.0 - t) * t * t * cy2
 	  + t * t * t * y2;
 }
 
+//------------------------------------------------------------------------------
+/*virtual*/ Bounds CubicBezierCurve::ComputeBounds() const
+{
+	Bounds bounds;
+	bounds.Add(x1, y1);
+	bounds.Add(x2, y2);
+
+	// Extrema are the roots of the derivative, a quadratic a*t^2 + b*t + c per axis (scaled by 1/3)
+	const double start[] = { x1, y1 };
+	const double control1[] = { cx1, cy1 };
+	const double control2[] = { cx2, cy2 };
+	const double end[] = { x2, y2 };
+	for (int32_t axis = 0; axis < 2; ++axis)
+	{
+		const double a = -start[axis] + 3.0 * control1[axis] - 3.0 * control2[axis] + end[axis];
+		const double b = 2.0 * (start[axis] - 2.0 * control1[axis] + control2[axis]);
+		const double c = control1[axis] - start[axis];
+
+		double roots[2] = { -1.0, -1.0 };
+		if (std::abs(a) < 1e-12)
+		{
+			if (b != 0.0)
+			{
+				roots[0] = -c / b;
+			}
+		}
+		else
+		{
+			const double discriminant = b * b - 4.0 * a * c;
+			if (discriminant >= 0.0)
+			{
+				const double root = std::sqrt(discriminant);
+				roots[0] = (-b + root) / (2.0 * a);
+				roots[1] = (-b - root) / (2.0 * a);
+			}
+		}
+
+		for (double t : roots)
+		{
+			if (t > 0.0 && t < 1.0)
+			{
+				double x = 0.0;
+				double y = 0.0;
+				ComputeXY(t, x, y);
+				bounds.Add(x, y);
+			}
+		}
+	}
+
+	// The stroke is extruded by its full width from the curve
+	bounds.Inflate(strokeWidth);
+	return bounds;
+}
+
+
+//------------------------------------------------------------------------------
+PolyLine::PolyLine(const Point* points, size_t count)
+	: points(points, points + count)
+{
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void PolyLine::Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const
+{
+	// The simplification only depends on the zoom so it is cached, while the decimation below depends on what is
+	// on screen
+	const int32_t columns = std::min(std::max(renderDevice->GetWidth(), 1), kMaxPolyLineColumns);
+	const std::vector<Point>& simplified = GetSimplified(renderDevice);
+
+	// Four points per pixel column is all the stroke can show, anything more gets decimated
+	std::vector<Point> decimated;
+	const std::vector<Point>* visible = &simplified;
+	if (simplified.size() > static_cast<size_t>(columns) * 4)
+	{
+		// Points are stored relative to the batch origin
+		const Bounds visibleBounds = renderDevice->GetCamera().GetVisibleBounds();
+		Decimate(simplified, visibleBounds.minX - originX, visibleBounds.maxX - originX, columns, decimated);
+		visible = &decimated;
+	}
+
+	size_t pointCount = visible->size();
+	if (pointCount < 2)
+	{
+		return;
+	}
+	if (pointCount > kMaxPolyLinePoints)
+	{
+		ASSERT(false, "PolyLine has too many visible points, truncating");
+		pointCount = kMaxPolyLinePoints;
+	}
+
+	// Room for every point to be beveled as far as the 16-bit indices allow, what isn't used is handed back on
+	// commit
+	const size_t vertexBudget = std::min(pointCount * 4, kMaxPolyLineVertices);
+	TessellationSpan span;
+	if (!sink.Reserve(vertexBudget, vertexBudget, PrimitiveTopology::TriangleStrip, span))
+	{
+		return;
+	}
+	const uint32_t style = span.baseStyle + kStrokeStyle;
+
+	// Rebase from the batch origin onto the render origin, only the difference needs double precision
+	double cameraOriginX = 0.0;
+	double cameraOriginY = 0.0;
+	renderDevice->GetCamera().GetOrigin(cameraOriginX, cameraOriginY);
+	const double offsetX = originX - cameraOriginX;
+	const float offsetY = static_cast<float>(originY - cameraOriginY);
+
+	// Positions on screen, without repeats so every segment has a direction
+	std::vector<float> xs;
+	std::vector<float> ys;
+	xs.reserve(pointCount);
+	ys.reserve(pointCount);
+	for (size_t i = 0; i < pointCount; ++i)
+	{
+		const float x = static_cast<float>((*visible)[i].x + offsetX);
+		const float y = (*visible)[i].y + offsetY;
+		if (xs.empty() || x != xs.back() || y != ys.back())
+		{
+			xs.push_back(x);
+			ys.push_back(y);
+		}
+	}
+	if (xs.size() < 2)
+	{
+		sink.Commit(0, 0);
+		return;
+	}
+
+	// One strip through every point, so the segments share their vertices and the widest decimated view still
+	// fits the 16-bit indices
+	size_t vertexCount = 0;
+	const auto emitPair = [&](float x, float y, float normalX, float normalY)
+	{
+		span.vertices[vertexCount] = Vertex(x + normalX, y + normalY, 0.0f, style);
+		span.vertices[vertexCount + 1] = Vertex(x - normalX, y - normalY, 0.0f, style);
+		span.indices[vertexCount] = static_cast<uint16_t>(span.baseVertex + vertexCount);
+		span.indices[vertexCount + 1] = static_cast<uint16_t>(span.baseVertex + vertexCount + 1);
+		vertexCount += 2;
+	};
+
+	const float halfWidth = strokeWidth * 0.5f;
+	const size_t count = xs.size();
+	float previousX = 0.0f;
+	float previousY = 0.0f;
+	for (size_t i = 0; i < count; ++i)
+	{
+		// Direction of the segment that starts here, the last point carries on the one before it
+		float nextX = previousX;
+		float nextY = previousY;
+		if (i + 1 < count)
+		{
+			nextX = xs[i + 1] - xs[i];
+			nextY = ys[i + 1] - ys[i];
+			const float length = std::sqrt(nextX * nextX + nextY * nextY);
+			nextX /= length;
+			nextY /= length;
+		}
+		if (i == 0)
+		{
+			previousX = nextX;
+			previousY = nextY;
+		}
+
+		// Joined along the miter, which halves the turn and gets longer the sharper the turn is
+		float miterX = -(previousY + nextY);
+		float miterY = previousX + nextX;
+		const float miterLength = std::sqrt(miterX * miterX + miterY * miterY);
+		float cosine = 0.0f;
+		if (miterLength > 0.0f)
+		{
+			miterX /= miterLength;
+			miterY /= miterLength;
+			cosine = miterX * -nextY + miterY * nextX;
+		}
+
+		if (cosine * kMaxMiterLength >= 1.0f)
+		{
+			emitPair(xs[i], ys[i], miterX * halfWidth / cosine, miterY * halfWidth / cosine);
+		}
+		else if (vertexCount + 4 + (count - i - 1) * 2 <= vertexBudget)
+		{
+			// Sharper turns end one segment square and start the next, the strip bevels across the gap
+			emitPair(xs[i], ys[i], -previousY * halfWidth, previousX * halfWidth);
+			emitPair(xs[i], ys[i], -nextY * halfWidth, nextX * halfWidth);
+		}
+		else
+		{
+			// Out of room for bevels, the miter is cut short and the stroke narrows into the turn
+			if (miterLength <= 0.0f)
+			{
+				miterX = -nextY;
+				miterY = nextX;
+				cosine = 1.0f;
+			}
+			const float scale = halfWidth * std::min(1.0f / std::max(cosine, 1e-6f), kMaxMiterLength);
+			emitPair(xs[i], ys[i], miterX * scale, miterY * scale);
+		}
+
+		previousX = nextX;
+		previousY = nextY;
+	}
+
+	sink.Commit(vertexCount, vertexCount);
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void PolyLine::GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const
+{
+	// Decimation keeps at most four points per column, plus the column at the right edge and one point past
+	// either side
+	const size_t columns = static_cast<size_t>(std::min(std::max(renderDevice->GetWidth(), 1), kMaxPolyLineColumns));
+	size_t pointCount = GetSimplified(renderDevice).size();
+	if (pointCount > columns * 4)
+	{
+		pointCount = std::min(pointCount, (columns + 1) * 4 + 2);
+	}
+
+	pointCount = pointCount < 2 ? 0 : std::min(pointCount, kMaxPolyLinePoints);
+	vertexCount = std::min(pointCount * 4, kMaxPolyLineVertices);
+	indexCount = vertexCount;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ Bounds PolyLine::ComputeBounds() const
+{
+	Bounds bounds;
+	for (const Point& point : points)
+	{
+		bounds.Add(originX + point.x, originY + point.y);
+	}
+	bounds.Inflate(strokeWidth * 0.5f);
+	return bounds;
+}
+
+//------------------------------------------------------------------------------
+const std::vector<Point>& PolyLine::GetSimplified(IRenderDevice* renderDevice) const
+{
+	// Detail finer than half a pixel can't be seen
+	static const double kSimplifyPixels = 0.5;
+	const double pixelsPerUnit = renderDevice->GetCamera().GetPixelsPerUnit(static_cast<float>(std::max(renderDevice->GetWidth(), 1)));
+	return GetSimplified(kSimplifyPixels / pixelsPerUnit);
+}
+
+//------------------------------------------------------------------------------
+const std::vector<Point>& PolyLine::GetSimplified(double tolerance) const
+{
+	// Entries of an unordered_map stay where they are as others are added, so the result outlives the lock
+	std::lock_guard<std::mutex> lock(mSimplifiedMutex);
+	if (mSimplifiedVersion != GetVersion())
+	{
+		mSimplified.clear();
+		mSimplifiedVersion = GetVersion();
+	}
+
+	if (points.size() < 3 || !(tolerance > 0.0))
+	{
+		return points;
+	}
+
+	// Rounding down keeps the error within the requested tolerance
+	const int32_t bucket = static_cast<int32_t>(std::floor(std::log2(tolerance)));
+	auto it = mSimplified.find(bucket);
+	if (it == mSimplified.end())
+	{
+		it = mSimplified.emplace(bucket, std::vector<Point>()).first;
+		Simplify(static_cast<float>(std::exp2(bucket)), it->second);
+
+		// Not worth the memory unless it at least halves the points
+		if (it->second.size() * 2 > points.size())
+		{
+			it->second.clear();
+			it->second.shrink_to_fit();
+		}
+	}
+
+	return it->second.empty() ? points : it->second;
+}
+
+//------------------------------------------------------------------------------
+void PolyLine::Simplify(float tolerance, std::vector<Point>& out) const
+{
+	out.clear();
+	if (points.size() < 3)
+	{
+		out = points;
+		return;
+	}
+
+	// Iterative so a million-point series can't overflow the stack
+	std::vector<bool> keep(points.size(), false);
+	keep.front() = true;
+	keep.back() = true;
+
+	std::vector<std::pair<size_t, size_t>> ranges;
+	ranges.emplace_back(0, points.size() - 1);
+	const float toleranceSquared = tolerance * tolerance;
+	while (!ranges.empty())
+	{
+		const size_t first = ranges.back().first;
+		const size_t last = ranges.back().second;
+		ranges.pop_back();
+
+		// Farthest point from the chord by squared perpendicular distance
+		const Point& start = points[first];
+		const Point& end = points[last];
+		const float dx = static_cast<float>(end.x - start.x);
+		const float dy = end.y - start.y;
+		const float lengthSquared = dx * dx + dy * dy;
+
+		size_t farthest = first;
+		float farthestDistance = 0.0f;
+		for (size_t i = first + 1; i < last; ++i)
+		{
+			const float px = static_cast<float>(points[i].x - start.x);
+			const float py = points[i].y - start.y;
+			float distance = 0.0f;
+			if (lengthSquared > 0.0f)
+			{
+				const float cross = dx * py - dy * px;
+				distance = cross * cross / lengthSquared;
+			}
+			else
+			{
+				distance = px * px + py * py;
+			}
+
+			if (distance > farthestDistance)
+			{
+				farthest = i;
+				farthestDistance = distance;
+			}
+		}
+
+		if (farthestDistance > toleranceSquared)
+		{
+			keep[farthest] = true;
+			if (farthest - first > 1)
+			{
+				ranges.emplace_back(first, farthest);
+			}
+			if (last - farthest > 1)
+			{
+				ranges.emplace_back(farthest, last);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		if (keep[i])
+		{
+			out.push_back(points[i]);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+/*static*/ void PolyLine::Decimate(const std::vector<Point>& points, double left, double right, int32_t columns, std::vector<Point>& out)
+{
+	out.clear();
+	if (points.empty() || columns <= 0 || !(left < right))
+	{
+		return;
+	}
+
+	const auto lessX = [](const Point& point, double x) { return point.x < x; };
+	const auto greaterX = [](double x, const Point& point) { return x < point.x; };
+
+	// Visible range plus one point on either side so the stroke continues off screen
+	size_t first = std::lower_bound(points.begin(), points.end(), left, lessX) - points.begin();
+	size_t last = std::upper_bound(points.begin(), points.end(), right, greaterX) - points.begin();
+	first = first > 0 ? first - 1 : 0;
+	last = std::min(last + 1, points.size());
+
+	out.reserve(static_cast<size_t>(columns) * 4 + 2);
+
+	const double columnsPerUnit = columns / (right - left);
+	size_t bucketFirst = first;
+	size_t bucketMin = first;
+	size_t bucketMax = first;
+	int64_t bucket = static_cast<int64_t>(std::floor((points[first].x - left) * columnsPerUnit));
+
+	const auto flushBucket = [&](size_t bucketLast)
+	{
+		// Emit in original order, skipping duplicates
+		size_t ordered[] = { bucketFirst, bucketMin, bucketMax, bucketLast };
+		std::sort(std::begin(ordered), std::end(ordered));
+		for (size_t i = 0; i < 4; ++i)
+		{
+			if (i == 0 || ordered[i] != ordered[i - 1])
+			{
+				out.push_back(points[ordered[i]]);
+			}
+		}
+	};
+
+	for (size_t i = first + 1; i < last; ++i)
+	{
+		const Point& point = points[i];
+		const int64_t pointBucket = static_cast<int64_t>(std::floor((point.x - left) * columnsPerUnit));
+		if (pointBucket != bucket)
+		{
+			flushBucket(i - 1);
+			bucket = pointBucket;
+			bucketFirst = i;
+			bucketMin = i;
+			bucketMax = i;
+			continue;
+		}
+
+		if (point.y < points[bucketMin].y)
+		{
+			bucketMin = i;
+		}
+		if (point.y > points[bucketMax].y)
+		{
+			bucketMax = i;
+		}
+	}
+	flushBucket(last - 1);
+}
+
+//------------------------------------------------------------------------------
+PointCloud::PointCloud(MarkerShape markerShape)
+	: markerShape(markerShape)
+{
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void PointCloud::Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const
+{
+	// Only used by devices without instancing, every marker becomes a square
+	size_t count = markers.size();
+	if (count > kMaxTessellatedMarkers)
+	{
+		ASSERT(false, "PointCloud has too many markers to tessellate, truncating");
+		count = kMaxTessellatedMarkers;
+	}
+
+	TessellationSpan span;
+	if (count == 0 || !sink.Reserve(count * 4, count * 6, PrimitiveTopology::TriangleList, span))
+	{
+		return;
+	}
+
+	double cameraOriginX = 0.0;
+	double cameraOriginY = 0.0;
+	renderDevice->GetCamera().GetOrigin(cameraOriginX, cameraOriginY);
+	const float offsetX = static_cast<float>(originX - cameraOriginX);
+	const float offsetY = static_cast<float>(originY - cameraOriginY);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Marker& marker = markers[i];
+		const float x = marker.x + offsetX;
+		const float y = marker.y + offsetY;
+		const float halfSize = marker.size * 0.5f;
+
+		// One style per marker, see GetStyles
+		const uint32_t style = span.baseStyle + static_cast<uint32_t>(i);
+		const uint16_t base = static_cast<uint16_t>(span.baseVertex + i * 4);
+		Vertex* vertices = span.vertices + i * 4;
+		vertices[0] = Vertex(x - halfSize, y - halfSize, 0.0f, style);
+		vertices[1] = Vertex(x + halfSize, y - halfSize, 0.0f, style);
+		vertices[2] = Vertex(x + halfSize, y + halfSize, 0.0f, style);
+		vertices[3] = Vertex(x - halfSize, y + halfSize, 0.0f, style);
+
+		const uint16_t indices[] = { 0, 1, 2, 0, 2, 3 };
+		uint16_t* out = span.indices + i * 6;
+		for (size_t k = 0; k < 6; ++k)
+		{
+			out[k] = base + indices[k];
+		}
+	}
+	sink.Commit(count * 4, count * 6);
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void PointCloud::GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const
+{
+	const size_t count = std::min(markers.size(), kMaxTessellatedMarkers);
+	vertexCount = count * 4;
+	indexCount = count * 6;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ uint32_t PointCloud::GetStyleCount() const
+{
+	return static_cast<uint32_t>(std::min(markers.size(), kMaxTessellatedMarkers));
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ void PointCloud::GetStyles(Style* styles) const
+{
+	const size_t count = GetStyleCount();
+	for (size_t i = 0; i < count; ++i)
+	{
+		styles[i].r = markers[i].r / 255.0f;
+		styles[i].g = markers[i].g / 255.0f;
+		styles[i].b = markers[i].b / 255.0f;
+		styles[i].a = markers[i].a / 255.0f;
+	}
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ Style PointCloud::GetCoverage(double pixelsPerUnit) const
+{
+	// The markers carry the colors, the shape's stroke and fill are unused
+	const double shapeArea = markerShape == MarkerShape::Circle ? 0.25 * 3.14159265358979323846 : 1.0;
+	double r = 0.0;
+	double g = 0.0;
+	double b = 0.0;
+	double weight = 0.0;
+	for (const Marker& marker : markers)
+	{
+		const double size = marker.size * pixelsPerUnit;
+		const double coverage = size * size * shapeArea * marker.a / 255.0;
+		r += marker.r * coverage;
+		g += marker.g * coverage;
+		b += marker.b * coverage;
+		weight += coverage;
+	}
+
+	Style coverage;
+	if (weight > 0.0)
+	{
+		coverage.r = static_cast<float>(r / (weight * 255.0));
+		coverage.g = static_cast<float>(g / (weight * 255.0));
+		coverage.b = static_cast<float>(b / (weight * 255.0));
+		coverage.a = static_cast<float>(std::min(weight, 1.0));
+	}
+	return coverage;
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool PointCloud::DrawDirect(IRenderDevice* renderDevice) const
+{
+	return renderDevice->DrawMarkers(markers.data(), markers.size(), markerShape, originX, originY);
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ bool PointCloud::HasDirectPath(IRenderDevice* renderDevice) const
+{
+	return renderDevice->HasDirectMarkers();
+}
+
+//------------------------------------------------------------------------------
+/*virtual*/ Bounds PointCloud::ComputeBounds() const
+{
+	Bounds bounds;
+	for (const Marker& marker : markers)
+	{
+		const double halfSize = marker.size * 0.5;
+		bounds.Add(originX + marker.x - halfSize, originY + marker.y - halfSize);
+		bounds.Add(originX + marker.x + halfSize, originY + marker.y + halfSize);
+	}
+	return bounds;
+}
+
+//------------------------------------------------------------------------------
+void PointCloud::AddMarker(double x, double y, float size, float r, float g, float b, float a)
+{
+	const auto toByte = [](float value)
+	{
+		return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	};
+
+	Marker marker;
+	marker.x = static_cast<float>(x - originX);
+	marker.y = static_cast<float>(y - originY);
+	marker.size = size;
+	marker.r = toByte(r);
+	marker.g = toByte(g);
+	marker.b = toByte(b);
+	marker.a = toByte(a);
+	markers.push_back(marker);
+
+	Invalidate();
+}
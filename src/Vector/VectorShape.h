@@ -3,32 +3,77 @@
 // Renderer
 #include <Renderer/IRenderDevice.h>
 
+// Utils
+#include <Utils/Bounds.h>
+
 // System
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 //------------------------------------------------------------------------------
 struct TessellationData
 {
 	std::vector<Vertex> vertices;	// Position, color
-	std::vector<uint16_t> indices;	// Triangle indices
+	std::vector<uint16_t> indices;	// Triangle indices, in the order the topology calls for
+	PrimitiveTopology topology = PrimitiveTopology::TriangleList;
 
-	void SetVertices(const Vertex* data, size_t size)
-	{
-		vertices.assign(data, (const Vertex*)((const char*)data + size));
-	}
+	// Welds duplicate vertices, strips degenerate triangles and reorders for the post-transform vertex cache.
+	// Too slow to run every frame, meant for meshes that are retained. Strips are left as they are.
+	void Optimize();
+};
 
-	void SetIndices(const uint16_t* data, size_t size)
-	{
-		indices.assign(data, (const uint16_t*)((const char*)data + size));
-	}
+// Room reserved in a tessellation sink. Indices refer to the whole buffer, so shapes add the base vertex to their
+// own (strip restarts excepted), and the base style to their local style indices.
+//------------------------------------------------------------------------------
+struct TessellationSpan
+{
+	Vertex* vertices = nullptr;
+	uint16_t* indices = nullptr;
+	uint16_t baseVertex = 0;
+	uint32_t baseStyle = 0;
+};
 
-	void Normalize()
-	{
-		for (Vertex& vertex : vertices)
-		{
-			vertex.Normalize();
-		}
-	}
+// Destination for tessellated geometry, such as a batch buffer or a mapped device buffer. Shapes reserve an upper
+// bound, write every vertex and index once in place, then commit how much of it they used. Each Reserve must be
+// followed by a Commit before the next.
+//------------------------------------------------------------------------------
+class ITessellationSink
+{
+public:
+	virtual ~ITessellationSink() = default;
+
+	// Returns false if the sink can't take that much, the shape then emits nothing
+	virtual bool Reserve(size_t vertexCount, size_t indexCount, PrimitiveTopology topology, TessellationSpan& span) = 0;
+	virtual void Commit(size_t vertexCount, size_t indexCount) = 0;
+};
+
+// Appends to a TessellationData, separating consecutive strips with a restart
+//------------------------------------------------------------------------------
+class TessellationDataSink : public ITessellationSink
+{
+public:
+	TessellationDataSink(TessellationData& data, uint32_t baseStyle = 0);
+
+	virtual bool Reserve(size_t vertexCount, size_t indexCount, PrimitiveTopology topology, TessellationSpan& span) override;
+	virtual void Commit(size_t vertexCount, size_t indexCount) override;
+
+private:
+	TessellationData& mData;
+	uint32_t mBaseStyle = 0;
+
+	// Where the pending reservation starts
+	size_t mVertexStart = 0;
+	size_t mIndexStart = 0;
+	size_t mRestartCount = 0;
+};
+
+// x is a double so that in series of tens of millions of samples, neighbors far from the origin stay apart
+//------------------------------------------------------------------------------
+struct Point
+{
+	double x = 0.0;
+	float y = 0.0f;
 };
 
 //------------------------------------------------------------------------------
@@ -37,11 +82,69 @@ class IVectorShape
 public:
 	virtual ~IVectorShape() = default;
 
-	virtual TessellationData Tessellate(IRenderDevice* renderDevice) const = 0;
+	// Writes the tessellation straight into the sink, relative to the camera's render origin
+	virtual void Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const = 0;
+
+	// Upper bound of what Tessellate emits for the same view, cheap enough to query for every shape before
+	// reserving space for a batch
+	virtual void GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const = 0;
+
+	// Draws through a device fast path, returns false if the shape must be tessellated instead
+	virtual bool DrawDirect(IRenderDevice* renderDevice) const;
+
+	// Whether DrawDirect can succeed at all, depending on the device and view. Shapes without a fast path are
+	// batched with the other tessellated shapes without trying.
+	virtual bool HasDirectPath(IRenderDevice* renderDevice) const { return false; }
 
 	virtual void SetStroke(float r, float g, float b, float a, float width);
 	virtual void SetFill(float r, float g, float b, float a);
 
+	// Conservative extent including the stroke, cached until the shape is invalidated. The first call after that
+	// writes the cache, so it must not race with other readers: Scene fills it before a shape can be shared, and
+	// the renderer reads it on its own thread before handing shapes to the rebuild workers.
+	const Bounds& GetBounds() const
+	{
+		if (!mBoundsValid)
+		{
+			mBounds = ComputeBounds();
+			mBoundsValid = true;
+		}
+		return mBounds;
+	}
+
+	// Must be called after changing the public geometry fields directly. Restyles too, geometry like PointCloud's
+	// markers carries its own colors
+	void Invalidate()
+	{
+		mBoundsValid = false;
+		++mVersion;
+		++mStyleVersion;
+	}
+
+	// Must be called after changing the public color fields directly, the setters call it
+	void InvalidateStyles() { ++mStyleVersion; }
+
+	// Changes whenever the shape is invalidated, so retained tessellations can tell they are stale
+	uint32_t GetVersion() const { return mVersion; }
+
+	// Changes whenever the colors or the geometry do, so the shape's palette entries are only rewritten then
+	uint32_t GetStyleVersion() const { return mStyleVersion; }
+
+	// Palette entries the tessellated vertices refer to, indexed from the shape's first entry. Recoloring only
+	// rewrites these, so it doesn't need the shape to be invalidated
+	virtual uint32_t GetStyleCount() const { return 2; }
+	virtual void GetStyles(Style* styles) const;
+
+	// Average color of the shape once it is smaller than a pixel, with the alpha scaled by the fraction of the
+	// pixel it covers. Sub-pixel shapes are drawn as this rather than their outline
+	virtual Style GetCoverage(double pixelsPerUnit) const;
+
+	// Tessellation depends on the camera or viewport and must be redone when the view changes
+	virtual bool IsViewDependent() const { return false; }
+
+	// Tessellation detail follows the zoom and must be redone when the camera's zoom level changes
+	virtual bool IsZoomDependent() const { return false; }
+
 	// Stroke
 	float strokeWidth = 0.0f;
 	float strokeR = 0.0f;
@@ -54,6 +157,19 @@ public:
 	float fillG = 0.0f;
 	float fillB = 0.0f;
 	float fillA = 0.0f;
+
+protected:
+	virtual Bounds ComputeBounds() const = 0;
+
+	// Local style indices for the vertices of the default styles
+	static const uint32_t kStrokeStyle = 0;
+	static const uint32_t kFillStyle = 1;
+
+private:
+	mutable Bounds mBounds;
+	mutable bool mBoundsValid = false;
+	uint32_t mVersion = 0;
+	uint32_t mStyleVersion = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -61,17 +177,23 @@ class Line : public IVectorShape
 {
 public:
 	Line() = default;
-	Line(float x1, float y1, float x2, float y2);
+	Line(double x1, double y1, double x2, double y2);
 
-	virtual TessellationData Tessellate(IRenderDevice* renderDevice) const override;
+	virtual void Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const override;
+	virtual void GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const override;
+	virtual bool DrawDirect(IRenderDevice* renderDevice) const override;
+	virtual bool HasDirectPath(IRenderDevice* renderDevice) const override;
 
 	// Start point
-	float x1 = 0.0f;
-	float y1 = 0.0f;
+	double x1 = 0.0;
+	double y1 = 0.0;
 
 	// End point
-	float x2 = 0.0f;
-	float y2 = 0.0f;
+	double x2 = 0.0;
+	double y2 = 0.0;
+
+protected:
+	virtual Bounds ComputeBounds() const override;
 };
 
 //------------------------------------------------------------------------------
@@ -79,17 +201,23 @@ class Rect : public IVectorShape
 {
 public:
 	Rect() = default;
-	Rect(float x, float y, float width, float height);
+	Rect(double x, double y, double width, double height);
 
-	virtual TessellationData Tessellate(IRenderDevice* renderDevice) const override;
+	virtual void Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const override;
+	virtual void GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const override;
+	virtual bool DrawDirect(IRenderDevice* renderDevice) const override;
+	virtual bool HasDirectPath(IRenderDevice* renderDevice) const override;
 
 	// Top-left
-	float x = 0.0f;
-	float y = 0.0f;
+	double x = 0.0;
+	double y = 0.0;
 
 	// Size
-	float width = 0.0f;
-	float height = 0.0f;
+	double width = 0.0;
+	double height = 0.0;
+
+protected:
+	virtual Bounds ComputeBounds() const override;
 };
 
 //------------------------------------------------------------------------------
@@ -97,33 +225,122 @@ class BezierCurve : public IVectorShape
 {
 public:
 	BezierCurve() = default;
-	BezierCurve(float x1, float y1, float x2, float y2, float cx1, float cy1);
+	BezierCurve(double x1, double y1, double x2, double y2, double cx1, double cy1);
+
+	virtual void Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const override;
+	virtual void GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const override;
+	virtual bool IsZoomDependent() const override { return true; }
+	virtual void ComputeXY(double t, double& x, double& y) const;
 
-	virtual TessellationData Tessellate(IRenderDevice* renderDevice) const override;
-	virtual void ComputeXY(float t, float& x, float& y) const;
+	// Segments to flatten into at the current zoom
+	int32_t GetSegmentCount(IRenderDevice* renderDevice) const;
 
 	// Start point
-	float x1 = 0.0f;
-	float y1 = 0.0f;
+	double x1 = 0.0;
+	double y1 = 0.0;
 
 	// End point
-	float x2 = 0.0f;
-	float y2 = 0.0f;
+	double x2 = 0.0;
+	double y2 = 0.0;
 
 	// Control point 1
-	float cx1 = 0.0f;
-	float cy1 = 0.0f;
+	double cx1 = 0.0;
+	double cy1 = 0.0;
+
+protected:
+	virtual Bounds ComputeBounds() const override;
 };
 
 //------------------------------------------------------------------------------
 class CubicBezierCurve : public BezierCurve
 {
 public:
-	CubicBezierCurve(float x1, float y1, float x2, float y2, float cx1, float cy1, float cx2, float cy2);
+	CubicBezierCurve(double x1, double y1, double x2, double y2, double cx1, double cy1, double cx2, double cy2);
 
-	virtual void ComputeXY(float t, float& x, float& y) const override;
+	virtual void ComputeXY(double t, double& x, double& y) const override;
 
 	// Control point 2
-	float cx2 = 0.0f;
-	float cy2 = 0.0f;
+	double cx2 = 0.0;
+	double cy2 = 0.0;
+
+protected:
+	virtual Bounds ComputeBounds() const override;
+};
+
+// Stroked series of connected points, simplified for the zoom level and decimated to the screen's pixel columns
+// at render time (not "Polyline", which clashes with the GDI function from windows.h)
+//------------------------------------------------------------------------------
+class PolyLine : public IVectorShape
+{
+public:
+	PolyLine() = default;
+	PolyLine(const Point* points, size_t count);
+
+	virtual void Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const override;
+	virtual void GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const override;
+	virtual bool IsViewDependent() const override { return true; }
+
+	// Douglas-Peucker simplification, drops points closer than the tolerance to the line through their neighbors
+	void Simplify(float tolerance, std::vector<Point>& out) const;
+
+	// Min/max-per-column (M4) reduction of the given points within [left, right] (relative to the origin),
+	// keeping the first and last point of every column so the stroke looks the same as the full series
+	static void Decimate(const std::vector<Point>& points, double left, double right, int32_t columns, std::vector<Point>& out);
+
+	// Batch origin, the points are offsets from it
+	double originX = 0.0;
+	double originY = 0.0;
+
+	// Sorted by x, as in a time series
+	std::vector<Point> points;
+
+protected:
+	virtual Bounds ComputeBounds() const override;
+
+private:
+	// Points simplified to the power-of-two tolerance bucket at or below the given tolerance
+	const std::vector<Point>& GetSimplified(double tolerance) const;
+
+	// Simplified points for the current zoom
+	const std::vector<Point>& GetSimplified(IRenderDevice* renderDevice) const;
+
+	// Keyed by the tolerance's power of two, an empty entry means simplifying didn't pay off. Renderers on other
+	// threads may draw the same shape from a shared snapshot at different zooms, so entries are added under the
+	// mutex. They aren't removed until the shape changes, which a shared shape doesn't.
+	mutable std::mutex mSimplifiedMutex;
+	mutable std::unordered_map<int32_t, std::vector<Point>> mSimplified;
+	mutable uint32_t mSimplifiedVersion = 0;
+};
+
+// Markers stored as packed instance data rather than one shape each, drawn as instanced quads
+//------------------------------------------------------------------------------
+class PointCloud : public IVectorShape
+{
+public:
+	PointCloud() = default;
+	PointCloud(MarkerShape markerShape);
+
+	virtual void Tessellate(IRenderDevice* renderDevice, ITessellationSink& sink) const override;
+	virtual void GetTessellationSize(IRenderDevice* renderDevice, size_t& vertexCount, size_t& indexCount) const override;
+	virtual bool DrawDirect(IRenderDevice* renderDevice) const override;
+	virtual bool HasDirectPath(IRenderDevice* renderDevice) const override;
+
+	// One style per marker, only used by the tessellated fallback
+	virtual uint32_t GetStyleCount() const override;
+	virtual void GetStyles(Style* styles) const override;
+	virtual Style GetCoverage(double pixelsPerUnit) const override;
+
+	// Position is in world space and stored relative to the origin
+	void AddMarker(double x, double y, float size, float r, float g, float b, float a);
+
+	MarkerShape markerShape = MarkerShape::Circle;
+
+	// Batch origin, marker positions are float offsets from it
+	double originX = 0.0;
+	double originY = 0.0;
+
+	std::vector<Marker> markers;
+
+protected:
+	virtual Bounds ComputeBounds() const override;
 };